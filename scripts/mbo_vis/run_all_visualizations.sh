@@ -3,6 +3,8 @@
 # This script runs the mbo-visualizer Docker container for each DBN file
 # found in the test_data directory and its subdirectories.
 # It generates unique SVG and PNG visualization files for each DBN file.
+# For depth heatmaps alone, ./heatmap renders whole directories natively in
+# one pass per file, without Docker or a timeout.
 
 # Ensure the mbo-visualizer Docker image is built:
 # docker build -t mbo-visualizer .
@@ -0,0 +1,66 @@
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "databento/record.hpp"
+
+#include "Analytics.h"
+#include "FlatMapOrderBook.h"
+#include "ParallelDbnReader.h"
+#include "cli.h"
+
+// One book per instrument, with its statistics
+struct Instrument {
+  explicit Instrument(const analytics::Config &config) : stage{config} {}
+
+  // The stage reads the top of book the book publishes
+  using Book = BasicFlatMapOrderBook<NullEventSink, BookFeatures::PublishTop>;
+  Book book{MatchMode::CrossLocally, Book::kInstrumentPoolSize};
+  analytics::Stage stage;
+};
+
+void run_analytics(const std::string &dbn_file_path,
+                   const std::string &output_path,
+                   const analytics::Config &config) {
+  std::cout << "Generating " << output_path << std::endl;
+  std::unordered_map<uint32_t, std::unique_ptr<Instrument>> instruments;
+  analytics::Writer writer{output_path, config};
+
+  ParallelDbnReader reader{dbn_file_path};
+  while (const databento::Record *record = reader.NextRecord()) {
+    if (record->RType() == databento::RType::Mbo) {
+      const auto &msg = record->Get<databento::MboMsg>();
+      auto &instrument = instruments[msg.hd.instrument_id];
+      if (!instrument) {
+        instrument = std::make_unique<Instrument>(config);
+      }
+      instrument->book.ProcessMboMsg(msg);
+      writer.Write(instrument->stage.Update(msg, instrument->book));
+    }
+  }
+  writer.Flush();
+}
+
+// Writes imbalance, microprice, spread and message rates after every
+// message of each file to artifacts/analytics/<file>.msta
+int main(int argc, char **argv) {
+  analytics::Config config;
+  config.top_levels = std::stoul(cli::get_option(argc, argv, "top", "5"));
+  config.window_nanos =
+      std::stoull(cli::get_option(argc, argv, "window-ns", "1000000000"));
+  const std::string output_dir =
+      cli::get_option(argc, argv, "output-dir", "artifacts/analytics");
+  std::filesystem::create_directories(output_dir);
+
+  for (const auto &dbn_file_path : cli::get_dbn_files(argc, argv)) {
+    const std::string filename =
+        std::filesystem::path{dbn_file_path}.filename().string();
+    run_analytics(dbn_file_path,
+                  (std::filesystem::path{output_dir} / (filename + ".msta"))
+                      .string(),
+                  config);
+  }
+  return 0;
+}
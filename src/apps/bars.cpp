@@ -0,0 +1,128 @@
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "databento/record.hpp"
+
+#include "Bars.h"
+#include "FlatMapOrderBook.h"
+#include "ParallelDbnReader.h"
+#include "cli.h"
+
+struct Instrument;
+
+// Passes the fills of a crossing book on to its instrument's bars
+struct FillSink {
+  Instrument *instrument;
+  void OnFill(const FillEvent &fill);
+  void OnLevelAdded(const LevelEvent &) {}
+  void OnLevelRemoved(const LevelEvent &) {}
+  void OnBboChanged(const BboEvent &) {}
+};
+
+// A book and its bar in progress. Trades come from 'T' messages, and, in
+// CrossLocally mode, from the book's own fills when a feed leaves the book
+// crossed, as generated data does. An exchange feed reports every fill as
+// a 'T' already, so its books trust the feed and never match. 'F' messages
+// report the resting side of a trade already seen as a 'T', so they are
+// not counted again.
+struct Instrument {
+  Instrument(uint32_t instrument_id, const bars::Config &config,
+             bars::Writer &bar_writer, MatchMode mode)
+      : builder{instrument_id, config}, writer{bar_writer}, match_mode{mode},
+        book{FillSink{this}, mode, Book::kInstrumentPoolSize} {}
+
+  void AddTrade(Price price, uint64_t quantity) {
+    builder.AddTrade(ts_event, price, quantity,
+                     [this](const bars::Bar &bar) { writer.Write(bar); });
+  }
+
+  bars::Builder builder;
+  bars::Writer &writer;
+  uint64_t ts_event = 0; // Of the message being processed
+  MatchMode match_mode;
+  using Book = BasicFlatMapOrderBook<FillSink>;
+  Book book;
+};
+
+void FillSink::OnFill(const FillEvent &fill) {
+  if (instrument->match_mode == MatchMode::CrossLocally) {
+    instrument->AddTrade(fill.price, fill.quantity);
+  }
+}
+
+// --match-mode=trust-feed, the default, for exchange data, or
+// cross-locally for generated data
+MatchMode parse_match_mode(const std::string &name) {
+  if (name == "trust-feed") {
+    return MatchMode::TrustFeed;
+  }
+  if (name == "cross-locally") {
+    return MatchMode::CrossLocally;
+  }
+  throw std::invalid_argument("Invalid match mode: " + name);
+}
+
+void build_bars(const std::string &dbn_file_path,
+                const std::string &output_path, const bars::Config &config,
+                MatchMode match_mode) {
+  std::cout << "Generating " << output_path << std::endl;
+  bars::Writer writer{output_path, config};
+  std::unordered_map<uint32_t, std::unique_ptr<Instrument>> instruments;
+
+  ParallelDbnReader reader{dbn_file_path};
+  while (const databento::Record *record = reader.NextRecord()) {
+    if (record->RType() == databento::RType::Mbo) {
+      const auto &msg = record->Get<databento::MboMsg>();
+      auto &instrument = instruments[msg.hd.instrument_id];
+      if (!instrument) {
+        instrument = std::make_unique<Instrument>(msg.hd.instrument_id,
+                                                  config, writer, match_mode);
+      }
+      instrument->ts_event = msg.hd.ts_event.time_since_epoch().count();
+      if (msg.action == databento::Action::Trade) {
+        instrument->AddTrade(msg.price, msg.size);
+      }
+      instrument->book.ProcessMboMsg(msg);
+    }
+  }
+
+  for (auto &[instrument_id, instrument] : instruments) {
+    instrument->builder.Flush(
+        [&](const bars::Bar &bar) { writer.Write(bar); });
+  }
+  writer.Flush();
+}
+
+// Builds time, volume or tick bars for each file in the same pass as its
+// books, into artifacts/bars/<file>.<type>.bars
+int main(int argc, char **argv) {
+  const std::string type = cli::get_option(argc, argv, "type", "time");
+  bars::Config config;
+  config.type = bars::ParseBarType(type);
+  const std::string default_interval =
+      config.type == bars::BarType::Time     ? "60000000000"
+      : config.type == bars::BarType::Volume ? "10000"
+                                             : "100";
+  config.interval =
+      std::stoull(cli::get_option(argc, argv, "interval", default_interval));
+  const MatchMode match_mode = parse_match_mode(
+      cli::get_option(argc, argv, "match-mode", "trust-feed"));
+  const std::string output_dir =
+      cli::get_option(argc, argv, "output-dir", "artifacts/bars");
+  std::filesystem::create_directories(output_dir);
+
+  for (const auto &dbn_file_path : cli::get_dbn_files(argc, argv)) {
+    const std::string filename =
+        std::filesystem::path{dbn_file_path}.filename().string();
+    build_bars(dbn_file_path,
+               (std::filesystem::path{output_dir} /
+                (filename + "." + type + ".bars"))
+                   .string(),
+               config, match_mode);
+  }
+  return 0;
+}
@@ -4,40 +4,46 @@
 #include <fstream>
 #include <iostream>
 #include <numeric>
+#include <random>
 #include <string>
 #include <vector>
 
 #include <benchmark/benchmark.h>
 
-#include "databento/dbn_decoder.hpp"
-#include "databento/file_stream.hpp"
-#include "databento/log.hpp"
 #include "databento/record.hpp"
 
+#include "CustomAllocationMapOrderBook.h"
 #include "FlatMapOrderBook.h"
+#include "MatchingEngine.h"
+#include "MessageCache.h"
 #include "OrderBook.h"
+#include "RunMode.h"
+#include "cli.h"
 
-std::vector<databento::MboMsg>
-load_mbo_msgs(const std::filesystem::path &file_path) {
-  std::vector<databento::MboMsg> msgs;
-  databento::NullLogReceiver log_receiver;
-  databento::InFileStream file_stream{file_path};
-  databento::DbnDecoder decoder{&log_receiver, std::move(file_stream)};
+// Messages of the input file, rebuilt from its message cache before any
+// benchmark runs so that the timed loops only measure the books
+std::vector<databento::MboMsg> mbo_msgs_;
 
-  decoder.DecodeMetadata();
+// Each book runs in both match modes: CrossLocally matches only after an add
+// or modify that reaches the opposite touch, TrustFeed never matches
+static void BM_OrderBook_ProcessMsgLatency(benchmark::State &state,
+                                           MatchMode mode) {
+  OrderBook order_book{mode};
+  size_t i = 0;
 
-  while (const databento::Record *record = decoder.DecodeRecord()) {
-    if (record->RType() == databento::RType::Mbo) {
-      msgs.push_back(record->Get<databento::MboMsg>());
-    }
+  for (auto _ : state) {
+    order_book.ProcessMboMsg(mbo_msgs_[i]);
+    i = (i + 1) % mbo_msgs_.size();
   }
-  return msgs;
 }
+BENCHMARK_CAPTURE(BM_OrderBook_ProcessMsgLatency, CrossLocally,
+                  MatchMode::CrossLocally);
+BENCHMARK_CAPTURE(BM_OrderBook_ProcessMsgLatency, TrustFeed,
+                  MatchMode::TrustFeed);
 
-std::vector<databento::MboMsg> mbo_msgs_;
-
-static void BM_OrderBook_ProcessMsgLatency(benchmark::State &state) {
-  OrderBook order_book;
+static void BM_FlatMapOrderBook_ProcessMsgLatency(benchmark::State &state,
+                                                  MatchMode mode) {
+  FlatMapOrderBook order_book{mode};
   size_t i = 0;
 
   for (auto _ : state) {
@@ -45,10 +51,15 @@ static void BM_OrderBook_ProcessMsgLatency(benchmark::State &state) {
     i = (i + 1) % mbo_msgs_.size();
   }
 }
-BENCHMARK(BM_OrderBook_ProcessMsgLatency);
+BENCHMARK_CAPTURE(BM_FlatMapOrderBook_ProcessMsgLatency, CrossLocally,
+                  MatchMode::CrossLocally);
+BENCHMARK_CAPTURE(BM_FlatMapOrderBook_ProcessMsgLatency, TrustFeed,
+                  MatchMode::TrustFeed);
 
-static void BM_FlatMapOrderBook_ProcessMsgLatency(benchmark::State &state) {
-  FlatMapOrderBook order_book;
+static void
+BM_CustomAllocationMapOrderBook_ProcessMsgLatency(benchmark::State &state,
+                                                  MatchMode mode) {
+  CustomAllocationMapOrderBook order_book{mode};
   size_t i = 0;
 
   for (auto _ : state) {
@@ -56,16 +67,120 @@ static void BM_FlatMapOrderBook_ProcessMsgLatency(benchmark::State &state) {
     i = (i + 1) % mbo_msgs_.size();
   }
 }
-BENCHMARK(BM_FlatMapOrderBook_ProcessMsgLatency);
+BENCHMARK_CAPTURE(BM_CustomAllocationMapOrderBook_ProcessMsgLatency,
+                  CrossLocally, MatchMode::CrossLocally);
+BENCHMARK_CAPTURE(BM_CustomAllocationMapOrderBook_ProcessMsgLatency,
+                  TrustFeed, MatchMode::TrustFeed);
+
+struct EngineCommand {
+  enum class Kind { Limit, Market, Cancel } kind;
+  TimeInForce tif;
+  OrderId order_id;
+  char side;
+  Price price;
+  Quantity quantity;
+};
+
+// Synthetic order flow around a slowly drifting mid price: mostly resting
+// and marketable limits, some IOC and market sweeps, and cancels of recent
+// orders. Ids are offset by a lap count when the flow is replayed, so they
+// stay unique.
+std::vector<EngineCommand> make_engine_commands(size_t count) {
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<> kind_dist(0, 99);
+  std::uniform_int_distribution<> side_dist(0, 1);
+  std::uniform_int_distribution<> offset_dist(-10, 10);
+  std::uniform_int_distribution<> drift_dist(-1, 1);
+  std::uniform_int_distribution<Quantity> qty_dist(1, 100);
+  std::uniform_int_distribution<OrderId> recent_dist(1, 1000);
+
+  const Price tick = 1000000;
+  Price mid = 100000000000;
+  std::vector<EngineCommand> commands;
+  commands.reserve(count);
+
+  for (OrderId id = 1; id <= count; ++id) {
+    const int kind = kind_dist(gen);
+    const char side = side_dist(gen) == 0 ? 'B' : 'A';
+    const Price price = mid + offset_dist(gen) * tick;
+    mid += drift_dist(gen) * tick;
+
+    if (kind < 60) {
+      commands.push_back({EngineCommand::Kind::Limit,
+                          TimeInForce::GoodTillCancel, id, side, price,
+                          qty_dist(gen)});
+    } else if (kind < 70) {
+      commands.push_back({EngineCommand::Kind::Limit,
+                          TimeInForce::ImmediateOrCancel, id, side, price,
+                          qty_dist(gen)});
+    } else if (kind < 75) {
+      commands.push_back({EngineCommand::Kind::Market,
+                          TimeInForce::ImmediateOrCancel, id, side, 0,
+                          qty_dist(gen) * 5});
+    } else {
+      const OrderId target = id > 1000 ? id - recent_dist(gen) : 1;
+      commands.push_back({EngineCommand::Kind::Cancel,
+                          TimeInForce::GoodTillCancel, target, side, 0, 0});
+    }
+  }
+  return commands;
+}
+
+static void BM_MatchingEngine_OrderThroughput(benchmark::State &state) {
+  static const std::vector<EngineCommand> commands =
+      make_engine_commands(1000000);
+  MatchingEngine engine{1000000};
+  size_t i = 0;
+  OrderId lap_offset = 0;
+
+  for (auto _ : state) {
+    const EngineCommand &cmd = commands[i];
+    const OrderId order_id = cmd.order_id + lap_offset;
+    switch (cmd.kind) {
+    case EngineCommand::Kind::Limit:
+      benchmark::DoNotOptimize(engine.SubmitLimit(order_id, cmd.side,
+                                                  cmd.price, cmd.quantity,
+                                                  cmd.tif));
+      break;
+    case EngineCommand::Kind::Market:
+      benchmark::DoNotOptimize(
+          engine.SubmitMarket(order_id, cmd.side, cmd.quantity));
+      break;
+    case EngineCommand::Kind::Cancel:
+      benchmark::DoNotOptimize(engine.Cancel(order_id));
+      break;
+    }
+
+    if (++i == commands.size()) {
+      i = 0;
+      lap_offset += commands.size();
+    }
+  }
+  // Reported by Google Benchmark as items_per_second, i.e. orders/sec
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MatchingEngine_OrderThroughput);
 
 int main(int argc, char **argv) {
-  if (argc < 2) {
-    std::cerr << "Usage: " << argv[0] << " <path_to_dbn_file>" << std::endl;
+  const std::vector<std::string> args = cli::positional_args(argc, argv);
+  if (args.empty()) {
+    std::cerr << "Usage: " << argv[0]
+              << " <path_to_dbn_file> [--cpu=BOOK[,DECODER]] [--isolate]"
+                 " [--fifo=PRIORITY] [--direct-io]"
+              << std::endl;
     return 1;
   }
 
-  const std::string dbn_file_path = argv[1];
-  mbo_msgs_ = load_mbo_msgs(dbn_file_path);
+  const run_mode::Config run_config = cli::get_run_mode(argc, argv);
+  run_mode::EnterDecodePhase(run_config);
+
+  const std::string dbn_file_path = args.front();
+  const message_cache::View cache = message_cache::Open(
+      dbn_file_path, cli::has_option(argc, argv, "direct-io"));
+  mbo_msgs_.reserve(cache.size());
+  for (const databento::MboMsg msg : cache) {
+    mbo_msgs_.push_back(msg);
+  }
 
   if (mbo_msgs_.empty()) {
     std::cerr << "Error: No MBO messages loaded from " << dbn_file_path
@@ -73,6 +188,7 @@ int main(int argc, char **argv) {
     return 1;
   }
 
+  run_mode::EnterBookPhase(run_config);
   benchmark::Initialize(&argc, argv);
   benchmark::RunSpecifiedBenchmarks();
   return 0;
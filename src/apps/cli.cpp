@@ -3,11 +3,51 @@
 #include <filesystem>
 #include <iostream>
 
+namespace {
+
+bool is_option(const std::string &arg) { return arg.rfind("--", 0) == 0; }
+
+} // namespace
+
+std::vector<std::string> cli::positional_args(int argc, char **argv) {
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; ++i) {
+    if (!is_option(argv[i])) {
+      args.push_back(argv[i]);
+    }
+  }
+  return args;
+}
+
+bool cli::has_option(int argc, char **argv, const std::string &name) {
+  const std::string flag = "--" + name;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == flag || arg.rfind(flag + "=", 0) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string cli::get_option(int argc, char **argv, const std::string &name,
+                            const std::string &default_value) {
+  const std::string prefix = "--" + name + "=";
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg.rfind(prefix, 0) == 0) {
+      return arg.substr(prefix.size());
+    }
+  }
+  return default_value;
+}
+
 std::vector<std::string> cli::get_dbn_files(int argc, char **argv) {
   std::vector<std::string> dbn_files;
   std::string input_path;
+  const std::vector<std::string> args = positional_args(argc, argv);
 
-  if (argc < 2) {
+  if (args.empty()) {
     input_path = "../resources/test_data/";
     if (!std::filesystem::exists(input_path) ||
         !std::filesystem::is_directory(input_path)) {
@@ -17,7 +57,7 @@ std::vector<std::string> cli::get_dbn_files(int argc, char **argv) {
       exit(1);
     }
   } else {
-    input_path = argv[1];
+    input_path = args.front();
   }
 
   if (std::filesystem::is_directory(input_path)) {
@@ -40,3 +80,18 @@ std::vector<std::string> cli::get_dbn_files(int argc, char **argv) {
   }
   return dbn_files;
 }
+
+run_mode::Config cli::get_run_mode(int argc, char **argv) {
+  run_mode::Config config;
+  const std::string cpus = get_option(argc, argv, "cpu");
+  if (!cpus.empty()) {
+    const size_t comma = cpus.find(',');
+    config.book_cpu = std::stoi(cpus.substr(0, comma));
+    config.decoder_cpu = comma == std::string::npos
+                             ? config.book_cpu
+                             : std::stoi(cpus.substr(comma + 1));
+  }
+  config.isolate = has_option(argc, argv, "isolate");
+  config.fifo_priority = std::stoi(get_option(argc, argv, "fifo", "0"));
+  return config;
+}
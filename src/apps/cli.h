@@ -3,8 +3,24 @@
 #include <string>
 #include <vector>
 
+#include "RunMode.h"
+
 namespace cli {
 
+// Arguments that are not `--name` or `--name=value` options
+std::vector<std::string> positional_args(int argc, char **argv);
+
+bool has_option(int argc, char **argv, const std::string &name);
+
+// Value of `--name=value`, or default_value when the option is absent
+std::string get_option(int argc, char **argv, const std::string &name,
+                       const std::string &default_value = "");
+
 std::vector<std::string> get_dbn_files(int argc, char **argv);
 
-}
+// --cpu=BOOK[,DECODER] pins the book thread, and the decoder threads to
+// DECODER if given (otherwise they share BOOK). --isolate locks and
+// pre-faults memory; --fifo=PRIORITY runs the book under SCHED_FIFO.
+run_mode::Config get_run_mode(int argc, char **argv);
+
+} // namespace cli
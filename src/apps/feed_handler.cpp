@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "databento/record.hpp"
+
+#include "DatagramFeed.h"
+#include "FlatMapOrderBook.h"
+#include "cli.h"
+
+namespace {
+
+void usage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " --listen=<udp:HOST:PORT|unix:PATH> [--batch=N]" << std::endl;
+}
+
+uint64_t percentile(const std::vector<uint64_t> &sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  return sorted[static_cast<size_t>(p * (sorted.size() - 1))];
+}
+
+} // namespace
+
+// Feeds MBO records received from feed_publisher into a book and reports
+// wire-to-book latency: from the packet being sent to the book having
+// applied the record. Both ends read the same steady clock, so this only
+// works on one box.
+int main(int argc, char **argv) {
+  const std::string listen = cli::get_option(argc, argv, "listen");
+  if (listen.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+  const size_t batch = std::stoul(cli::get_option(argc, argv, "batch", "64"));
+
+  feed::Receiver receiver{listen, batch};
+  FlatMapOrderBook order_book;
+  std::vector<uint64_t> latencies;
+  latencies.reserve(1 << 20);
+
+  std::cout << "Listening on " << listen << std::endl;
+  while (receiver.Poll([&](const databento::Record &record,
+                           const feed::PacketHeader &header) {
+    if (record.RType() == databento::RType::Mbo) {
+      order_book.ProcessMboMsg(record.Get<databento::MboMsg>());
+      latencies.push_back(feed::SteadyNanos() - header.send_ts);
+    }
+  })) {
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  const feed::SequenceTracker &sequence = receiver.Sequence();
+  std::cout << "packets: " << receiver.packets() << "\n"
+            << "records: " << latencies.size() << "\n"
+            << "gaps: " << sequence.gaps()
+            << " (missing records: " << sequence.missing_records()
+            << ", stale packets: " << sequence.stale_packets() << ")\n"
+            << "wire-to-book latency ns: p50 " << percentile(latencies, 0.5)
+            << ", p99 " << percentile(latencies, 0.99) << ", p99.9 "
+            << percentile(latencies, 0.999) << ", max "
+            << (latencies.empty() ? 0 : latencies.back()) << "\n"
+            << "best bid: " << order_book.GetBestBid()
+            << ", best ask: " << order_book.GetBestAsk() << std::endl;
+  return 0;
+}
@@ -0,0 +1,61 @@
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "databento/record.hpp"
+
+#include "DatagramFeed.h"
+#include "DbnMergeReader.h"
+#include "Pacer.h"
+#include "cli.h"
+
+namespace {
+
+void usage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " <file.dbn>... --target=<udp:HOST:PORT|unix:PATH> [--speed=X]\n"
+            << "  --speed=1 replays at the original ts_recv spacing, 10 is ten "
+               "times faster and 0 (default) sends as fast as possible"
+            << std::endl;
+}
+
+} // namespace
+
+// Replays the MBO records of one or more DBN files, merged by ts_recv, onto a
+// datagram socket for feed_handler. Records released at the same instant
+// share a datagram.
+int main(int argc, char **argv) {
+  const std::vector<std::string> args = cli::positional_args(argc, argv);
+  const std::string target = cli::get_option(argc, argv, "target");
+  if (args.empty() || target.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+  const double speed = std::stod(cli::get_option(argc, argv, "speed", "0"));
+
+  DbnMergeReader reader{args};
+  feed::Sender sender{target};
+  Pacer pacer{speed};
+  uint64_t release = 0;
+  uint64_t records = 0;
+
+  while (const databento::MboMsg *msg = reader.Next()) {
+    if (speed > 0) {
+      const uint64_t next_release =
+          pacer.ReleaseTime(msg->ts_recv.time_since_epoch().count());
+      if (next_release > release) {
+        sender.Flush();
+        Pacer::WaitUntil(next_release);
+        release = next_release;
+      }
+    }
+    sender.Add(databento::Record{
+        const_cast<databento::RecordHeader *>(&msg->hd)});
+    ++records;
+  }
+  sender.Finish();
+
+  std::cout << "Sent " << records << " records to " << target << std::endl;
+  return 0;
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <filesystem>
@@ -7,13 +8,15 @@
 #include <string>
 #include <vector>
 
-#include "databento/dbn_decoder.hpp"
-#include "databento/file_stream.hpp"
-#include "databento/log.hpp"
 #include "databento/record.hpp"
 
+#include "CustomAllocationMapOrderBook.h"
+#include "DbnMergeReader.h"
 #include "FlatMapOrderBook.h"
+#include "MessageCache.h"
 #include "OrderBook.h"
+#include "Pacer.h"
+#include "RunMode.h"
 #include "cli.h"
 
 class Duration {
@@ -30,42 +33,153 @@ private:
   std::chrono::high_resolution_clock::time_point start_time;
 };
 
-std::vector<databento::MboMsg>
-load_mbo_msgs(const std::filesystem::path &file_path) {
+// The files to replay together. With --merge every file is replayed as one
+// stream interleaved by ts_recv, otherwise each file on its own.
+std::vector<std::vector<std::string>> get_replays(int argc, char **argv) {
+  const std::vector<std::string> files = cli::get_dbn_files(argc, argv);
+  if (cli::has_option(argc, argv, "merge")) {
+    return {files};
+  }
+  std::vector<std::vector<std::string>> replays;
+  for (const auto &file : files) {
+    replays.push_back({file});
+  }
+  return replays;
+}
+
+std::string replay_name(const std::vector<std::string> &paths) {
+  if (paths.size() == 1) {
+    return std::filesystem::path{paths.front()}.filename().string();
+  }
+  return "merged";
+}
+
+// A single file is mmap'd from its message cache, which is built on first
+// use, reading the DBN file with O_DIRECT if direct_io is set; a merged
+// replay is converted to columns in memory
+message_cache::View load_replay(const std::vector<std::string> &paths,
+                                bool direct_io) {
+  if (paths.size() == 1) {
+    return message_cache::Open(paths.front(), direct_io);
+  }
   std::vector<databento::MboMsg> msgs;
-  databento::NullLogReceiver log_receiver;
-  databento::InFileStream file_stream{file_path};
-  databento::DbnDecoder decoder{&log_receiver, std::move(file_stream)};
+  DbnMergeReader reader{paths};
+  while (const databento::MboMsg *msg = reader.Next()) {
+    msgs.push_back(*msg);
+  }
+  return message_cache::View{msgs};
+}
 
-  decoder.DecodeMetadata();
+message_cache::View mbo_msgs_;
 
-  while (const databento::Record *record = decoder.DecodeRecord()) {
-    if (record->RType() == databento::RType::Mbo) {
-      msgs.push_back(record->Get<databento::MboMsg>());
-    }
+// A message released at least this long after the previous one is counted
+// as arriving after an idle gap
+constexpr uint64_t kIdleGapNanos = 1000000;
+
+uint64_t percentile(const std::vector<uint64_t> &sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
   }
-  return msgs;
+  return sorted[static_cast<size_t>(p * (sorted.size() - 1))];
 }
 
-std::vector<databento::MboMsg> mbo_msgs_;
+// Replays mbo_msgs_ at their original ts_recv spacing divided by speed and
+// records, for every message, the time from its scheduled release to the
+// book having applied it. Unlike the full-speed loop this sees the book go
+// cold during idle gaps.
+template <typename Book>
+void run_paced(const std::string &name, double speed, std::ofstream &csv_file) {
+  Book order_book;
+  Pacer pacer{speed};
+  // Written out afterwards so the CSV stream stays out of the timed loop
+  std::vector<uint64_t> latencies;
+  latencies.reserve(mbo_msgs_.size());
+  std::vector<uint64_t> after_gap;
+  std::vector<uint64_t> in_burst;
+  uint64_t previous_release = 0;
+  Duration overall_duration;
+
+  for (const auto &msg : mbo_msgs_) {
+    const uint64_t release =
+        pacer.Release(msg.ts_recv.time_since_epoch().count());
+    order_book.ProcessMboMsg(msg);
+    latencies.push_back(Pacer::Now() - release);
+
+    const bool idle = release - previous_release >= kIdleGapNanos;
+    (idle ? after_gap : in_burst).push_back(latencies.back());
+    previous_release = release;
+  }
+  const long long overall = *overall_duration;
+
+  csv_file << name << ',' << mbo_msgs_.size() << ',';
+  for (uint64_t latency : latencies) {
+    csv_file << latency << ',';
+  }
+  csv_file << overall << "\n";
+
+  std::sort(after_gap.begin(), after_gap.end());
+  std::sort(in_burst.begin(), in_burst.end());
+  std::cout << name << ": after idle gaps p50 " << percentile(after_gap, 0.5)
+            << " p99 " << percentile(after_gap, 0.99) << " ns ("
+            << after_gap.size() << " msgs), in bursts p50 "
+            << percentile(in_burst, 0.5) << " p99 "
+            << percentile(in_burst, 0.99) << " ns (" << in_burst.size()
+            << " msgs)" << std::endl;
+}
 
 int main(int argc, char **argv) {
+  const run_mode::Config run_config = cli::get_run_mode(argc, argv);
+  const bool direct_io = cli::has_option(argc, argv, "direct-io");
+
+  // --speed=X replays at X times the original rate instead of full speed.
+  // As for feed_publisher, 0 means as fast as possible.
+  const double speed = std::stod(cli::get_option(argc, argv, "speed", "0"));
+  if (speed < 0) {
+    std::cerr << "Error: --speed must not be negative" << std::endl;
+    return 1;
+  }
+  if (speed > 0) {
+    std::ofstream csv_file("artifacts/paced_results.csv");
+
+    for (const auto &replay : get_replays(argc, argv)) {
+      run_mode::EnterDecodePhase(run_config);
+      mbo_msgs_ = load_replay(replay, direct_io);
+      run_mode::EnterBookPhase(run_config);
+      const std::string filename = replay_name(replay);
+
+      if (mbo_msgs_.empty()) {
+        std::cerr << "Error: No MBO messages loaded from " << filename
+                  << std::endl;
+        return 1;
+      }
+
+      run_paced<OrderBook>(filename + "OrderBook", speed, csv_file);
+      run_paced<FlatMapOrderBook>(filename + "FlatOrderBook", speed, csv_file);
+      run_paced<CustomAllocationMapOrderBook>(
+          filename + "CustomAllocationMapOrderBook", speed, csv_file);
+    }
+
+    std::cout << "Paced results written to paced_results.csv" << std::endl;
+    return 0;
+  }
+
   std::ofstream csv_file("artifacts/benchmark_results.csv");
 
-  for (const auto &dbn_file_path : cli::get_dbn_files(argc, argv)) {
-    mbo_msgs_ = load_mbo_msgs(dbn_file_path);
-    std::filesystem::path file_path{dbn_file_path};
+  for (const auto &replay : get_replays(argc, argv)) {
+    run_mode::EnterDecodePhase(run_config);
+    mbo_msgs_ = load_replay(replay, direct_io);
+    run_mode::EnterBookPhase(run_config);
+    const std::string filename = replay_name(replay);
 
     if (mbo_msgs_.empty()) {
-      std::cerr << "Error: No MBO messages loaded from " << dbn_file_path
+      std::cerr << "Error: No MBO messages loaded from " << filename
                 << std::endl;
       return 1;
     }
 
     // Benchmark OrderBook
     {
-      csv_file << file_path.filename().string() << "OrderBook,"
-               << mbo_msgs_.size() << ',';
+      csv_file << filename << "OrderBook," << mbo_msgs_.size() << ',';
 
       OrderBook order_book;
       Duration overall_duration;
@@ -80,8 +194,7 @@ int main(int argc, char **argv) {
 
     // Benchmark FlatMapOrderBook
     {
-      csv_file << file_path.filename().string() << "FlatOrderBook,"
-               << mbo_msgs_.size() << ',';
+      csv_file << filename << "FlatOrderBook," << mbo_msgs_.size() << ',';
 
       FlatMapOrderBook flat_map_order_book;
       Duration overall_duration;
@@ -93,6 +206,22 @@ int main(int argc, char **argv) {
       }
       csv_file << *overall_duration << "\n";
     }
+
+    // Benchmark CustomAllocationMapOrderBook
+    {
+      csv_file << filename << "CustomAllocationMapOrderBook,"
+               << mbo_msgs_.size() << ',';
+
+      CustomAllocationMapOrderBook custom_allocation_order_book;
+      Duration overall_duration;
+
+      for (const auto &msg : mbo_msgs_) {
+        Duration trade_duration;
+        custom_allocation_order_book.ProcessMboMsg(msg);
+        csv_file << *trade_duration << ',';
+      }
+      csv_file << *overall_duration << "\n";
+    }
   }
 
   csv_file.close();
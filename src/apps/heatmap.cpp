@@ -0,0 +1,99 @@
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "databento/record.hpp"
+
+#include "FlatMapOrderBook.h"
+#include "Heatmap.h"
+#include "ParallelDbnReader.h"
+#include "cli.h"
+#include "job_pool.h"
+
+// One book per instrument, with the depth matrix sampled from it into
+// <output_path>.heat
+struct Instrument {
+  Instrument(uint32_t instrument_id, const heatmap::Config &config,
+             const std::string &output_path)
+      : output_path{output_path},
+        recorder{instrument_id, config, output_path + ".heat"} {}
+
+  // The recorder bins the book's depth ladders
+  using Book = BasicFlatMapOrderBook<NullEventSink, BookFeatures::DepthQueries>;
+  Book book{MatchMode::CrossLocally, Book::kInstrumentPoolSize};
+  std::string output_path;
+  heatmap::Recorder recorder;
+};
+
+// Replays one file and writes <file>.<instrument>.heat and .png for each
+// instrument in it. Returns the number of instruments.
+size_t render_file(const std::string &dbn_file_path,
+                   const std::string &output_dir,
+                   const heatmap::Config &config,
+                   const heatmap::RenderConfig &render_config) {
+  std::unordered_map<uint32_t, std::unique_ptr<Instrument>> instruments;
+  const std::string filename =
+      std::filesystem::path{dbn_file_path}.filename().string();
+
+  ParallelDbnReader reader{dbn_file_path};
+  while (const databento::Record *record = reader.NextRecord()) {
+    if (record->RType() == databento::RType::Mbo) {
+      const auto &msg = record->Get<databento::MboMsg>();
+      auto &instrument = instruments[msg.hd.instrument_id];
+      if (!instrument) {
+        const std::string output_path =
+            (std::filesystem::path{output_dir} /
+             (filename + "." + std::to_string(msg.hd.instrument_id)))
+                .string();
+        instrument = std::make_unique<Instrument>(msg.hd.instrument_id,
+                                                  config, output_path);
+      }
+      instrument->recorder.Update(msg, instrument->book);
+      instrument->book.ProcessMboMsg(msg);
+    }
+  }
+
+  for (auto &[instrument_id, instrument] : instruments) {
+    instrument->recorder.Finish(instrument->book);
+    heatmap::Reader heat{instrument->output_path + ".heat"};
+    heatmap::WritePng(instrument->output_path + ".png", heat, render_config);
+  }
+  return instruments.size();
+}
+
+// Writes a binned price x time depth matrix and a PNG of it for each
+// instrument of each file to artifacts/heatmap/
+int main(int argc, char **argv) {
+  heatmap::Config config;
+  config.bin_nanos =
+      std::stoull(cli::get_option(argc, argv, "bin-ns", "1000000000"));
+  config.rows = std::stoul(cli::get_option(argc, argv, "rows", "256"));
+  config.price_step =
+      std::stoll(cli::get_option(argc, argv, "price-step", "0"));
+  heatmap::RenderConfig render_config;
+  render_config.max_width =
+      std::stoul(cli::get_option(argc, argv, "width", "1600"));
+  render_config.max_height =
+      std::stoul(cli::get_option(argc, argv, "height", "800"));
+  const size_t threads = std::stoul(cli::get_option(
+      argc, argv, "threads",
+      std::to_string(std::thread::hardware_concurrency())));
+  const std::string output_dir =
+      cli::get_option(argc, argv, "output-dir", "artifacts/heatmap");
+  std::filesystem::create_directories(output_dir);
+
+  job_pool::run(
+      cli::get_dbn_files(argc, argv), threads,
+      [&](const std::string &dbn_file_path) {
+        return render_file(dbn_file_path, output_dir, config, render_config);
+      },
+      [](const std::string &dbn_file_path, size_t instruments) {
+        std::cout << "Rendered " << instruments << " instruments from "
+                  << dbn_file_path << std::endl;
+      });
+  return 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace job_pool {
+
+// Runs run(job) for every job on up to `threads` threads, each taking the
+// next job until none are left. run is called with the pool's mutex
+// unlocked; report(job, result) is called with it held, so workers can
+// print without interleaving. The first exception stops the remaining jobs
+// and is rethrown once every thread has finished.
+template <typename Job, typename Run, typename Report>
+void run(const std::vector<Job> &jobs, size_t threads, Run run,
+         Report report) {
+  if (jobs.empty()) {
+    return;
+  }
+  std::atomic<size_t> next_job{0};
+  std::mutex mutex;
+  std::exception_ptr error;
+
+  auto worker = [&] {
+    for (size_t i = next_job++; i < jobs.size(); i = next_job++) {
+      try {
+        auto result = run(jobs[i]);
+        std::lock_guard<std::mutex> lock(mutex);
+        report(jobs[i], result);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        next_job = jobs.size();
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (size_t t = 0; t < std::clamp<size_t>(threads, 1, jobs.size()); ++t) {
+    pool.emplace_back(worker);
+  }
+  for (auto &thread : pool) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+} // namespace job_pool
@@ -1,24 +1,31 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
-#include "databento/dbn_decoder.hpp"
-#include "databento/file_stream.hpp"
-#include "databento/log.hpp"
 #include "databento/record.hpp"
 
+#include "CustomAllocationMapOrderBook.h"
 #include "FlatMapOrderBook.h"
 #include "OrderBook.h"
+#include "ParallelDbnReader.h"
+#include "SharedBook.h"
+#include "SnapshotSampler.h"
 #include "cli.h"
 
 std::ostream &nl(std::ostream &os) { return os << '\n'; }
 
 template <typename OrderBook>
 void generate_json_output(const std::string &dbn_file_path,
-                          const std::string &output_json_path) {
-  OrderBook order_book;
+                          const std::string &output_json_path,
+                          const SnapshotSampler::Config &sampling) {
+  // The sampler watches the top of book the book publishes
+  typename OrderBook::template WithFeatures<BookFeatures::PublishTop>
+      order_book;
+  SnapshotSampler sampler{sampling};
   std::cout << "Generating " << output_json_path << std::endl;
   std::ofstream output_file(output_json_path);
 
@@ -30,17 +37,16 @@ void generate_json_output(const std::string &dbn_file_path,
 
   output_file << "[" << nl;
 
-  databento::NullLogReceiver log_receiver;
-  databento::InFileStream file_stream{dbn_file_path};
-  databento::DbnDecoder decoder{&log_receiver, std::move(file_stream)};
-
-  decoder.DecodeMetadata();
+  ParallelDbnReader reader{dbn_file_path};
 
   bool first_record = true;
-  while (const databento::Record *record = decoder.DecodeRecord()) {
+  while (const databento::Record *record = reader.NextRecord()) {
     if (record->RType() == databento::RType::Mbo) {
       const auto &msg = record->Get<databento::MboMsg>();
       order_book.ProcessMboMsg(msg);
+      if (!sampler.Sample(msg, order_book)) {
+        continue;
+      }
 
       if (!first_record) {
         output_file << "," << nl;
@@ -77,18 +83,69 @@ void generate_json_output(const std::string &dbn_file_path,
   output_file.close();
 }
 
+// Replays a file into one book per instrument and publishes each book's top
+// of book to shared memory after every message, instead of writing JSON
+void publish_to_shared_memory(const std::string &dbn_file_path,
+                              shared_book::Publisher &publisher) {
+  std::cout << "Publishing " << dbn_file_path << std::endl;
+  using PublishingBook =
+      BasicFlatMapOrderBook<NullEventSink, BookFeatures::PublishTop>;
+  std::unordered_map<uint32_t, std::unique_ptr<PublishingBook>> books;
+
+  ParallelDbnReader reader{dbn_file_path};
+
+  while (const databento::Record *record = reader.NextRecord()) {
+    if (record->RType() == databento::RType::Mbo) {
+      const auto &msg = record->Get<databento::MboMsg>();
+      auto &book = books[msg.hd.instrument_id];
+      if (!book) {
+        book = std::make_unique<PublishingBook>(
+            MatchMode::CrossLocally, PublishingBook::kInstrumentPoolSize);
+      }
+      book->ProcessMboMsg(msg);
+      publisher.Publish(msg.hd.instrument_id, book->Published().Load());
+    }
+  }
+}
+
 int main(int argc, char **argv) {
+  // --shm=<name> publishes to a shared-memory segment for other processes
+  // (see shm_reader) instead of generating JSON
+  const std::string shm_name = cli::get_option(argc, argv, "shm");
+  if (!shm_name.empty()) {
+    shared_book::Publisher publisher(shm_name);
+    for (const auto &dbn_file_path : cli::get_dbn_files(argc, argv)) {
+      publish_to_shared_memory(dbn_file_path, publisher);
+    }
+    return 0;
+  }
+
+  // Without sampling options every message gets a snapshot
+  SnapshotSampler::Config sampling;
+  sampling.every_messages =
+      std::stoull(cli::get_option(argc, argv, "every", "0"));
+  sampling.every_nanos =
+      std::stoull(cli::get_option(argc, argv, "every-ns", "0"));
+  sampling.top_levels =
+      std::stoul(cli::get_option(argc, argv, "top-changes", "0"));
+
   for (const auto &dbn_file_path : cli::get_dbn_files(argc, argv)) {
     std::filesystem::path p(dbn_file_path);
     std::string filename = p.filename().string();
 
     std::filesystem::create_directories("artifacts/mbp");
-    generate_json_output<OrderBook>(dbn_file_path,
-                                    "artifacts/mbp/map_" + filename + ".json");
+    generate_json_output<OrderBook>(
+        dbn_file_path, "artifacts/mbp/map_" + filename + ".json", sampling);
 
     std::filesystem::create_directories("artifacts/mbp");
     generate_json_output<FlatMapOrderBook>(
-        dbn_file_path, "artifacts/mbp/flatmap_" + filename + ".json");
+        dbn_file_path, "artifacts/mbp/flatmap_" + filename + ".json",
+        sampling);
+
+    std::filesystem::create_directories("artifacts/mbp");
+    generate_json_output<CustomAllocationMapOrderBook>(
+        dbn_file_path, "artifacts/mbp/custom_alloc_map_" + filename + ".json",
+        sampling);
   }
 
   return 0;
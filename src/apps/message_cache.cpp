@@ -0,0 +1,32 @@
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "MessageCache.h"
+#include "cli.h"
+
+// Builds the columnar message cache next to each DBN file, unless it is
+// already up to date, and prints the file's action histogram from it
+int main(int argc, char **argv) {
+  for (const auto &dbn_file_path : cli::get_dbn_files(argc, argv)) {
+    const auto start = std::chrono::steady_clock::now();
+    const message_cache::View view = message_cache::Open(dbn_file_path);
+    const std::array<uint64_t, 256> histogram =
+        message_cache::ActionHistogram(view);
+    const double millis = std::chrono::duration<double, std::milli>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+
+    std::cout << message_cache::PathFor(dbn_file_path) << ": " << view.size()
+              << " messages, ready in " << millis << " ms\n";
+    for (size_t action = 0; action < histogram.size(); ++action) {
+      if (histogram[action] > 0) {
+        std::cout << "  " << static_cast<char>(action) << ": "
+                  << histogram[action] << "\n";
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,224 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "databento/record.hpp"
+
+#include "DbnFileReader.h"
+#include "FlatMapOrderBook.h"
+#include "ReplayIndex.h"
+#include "cli.h"
+
+namespace {
+
+constexpr uint64_t kDefaultIntervalMessages = 100000;
+constexpr uint64_t kNanosPerSecond = 1000000000;
+
+class Duration {
+public:
+  Duration() : start_time{std::chrono::high_resolution_clock::now()} {}
+
+  double Millis() const {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::high_resolution_clock::now() - start_time)
+        .count();
+  }
+
+private:
+  std::chrono::high_resolution_clock::time_point start_time;
+};
+
+void usage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " build <file.dbn> [--every-messages=N] [--every-ns=T]\n"
+            << "       " << program
+            << " query <file.dbn> (--ts=<ns|HH:MM:SS[.fraction]> | "
+               "--sequence=N)"
+            << std::endl;
+}
+
+int build(const std::string &dbn_path, uint64_t interval_messages,
+          uint64_t interval_ns) {
+  Duration duration;
+  DbnFileReader reader{dbn_path};
+  FlatMapOrderBook order_book;
+  replay_index::Builder builder{replay_index::PathFor(dbn_path),
+                                interval_messages, interval_ns};
+
+  builder.Add(order_book.CreateCheckpoint(), reader.DataOffset());
+  while (const databento::Record *record = reader.NextRecord()) {
+    if (record->RType() == databento::RType::Mbo) {
+      order_book.ProcessMboMsg(record->Get<databento::MboMsg>());
+      builder.OnMessage(order_book, reader.Offset());
+    }
+  }
+  builder.Finish();
+
+  std::cout << "Indexed " << order_book.Position().message_count
+            << " messages with " << builder.size() << " checkpoints into "
+            << replay_index::PathFor(dbn_path) << " in " << duration.Millis()
+            << " ms" << std::endl;
+  return 0;
+}
+
+bool is_digits(const std::string &value) {
+  return !value.empty() &&
+         value.find_first_not_of("0123456789") == std::string::npos;
+}
+
+// Accepts nanoseconds since the epoch, or a UTC time of day which is taken
+// to be on the same day as the first message in the file. Throws
+// std::invalid_argument or std::out_of_range for anything else.
+uint64_t parse_ts(const std::string &value, uint64_t first_ts_event) {
+  if (value.find(':') == std::string::npos) {
+    if (!is_digits(value)) {
+      throw std::invalid_argument("Invalid timestamp: " + value);
+    }
+    return std::stoull(value);
+  }
+
+  unsigned hours = 0, minutes = 0, seconds = 0;
+  if (std::sscanf(value.c_str(), "%u:%u:%u", &hours, &minutes, &seconds) !=
+      3) {
+    throw std::invalid_argument("Invalid time of day: " + value);
+  }
+
+  uint64_t fraction_ns = 0;
+  const size_t dot = value.find('.');
+  if (dot != std::string::npos) {
+    std::string digits = value.substr(dot + 1, 9);
+    if (!is_digits(digits)) {
+      throw std::invalid_argument("Invalid time of day: " + value);
+    }
+    digits.resize(9, '0');
+    fraction_ns = std::stoull(digits);
+  }
+
+  const uint64_t day_start =
+      first_ts_event - first_ts_event % (86400 * kNanosPerSecond);
+  return day_start +
+         (hours * 3600ull + minutes * 60ull + seconds) * kNanosPerSecond +
+         fraction_ns;
+}
+
+bool is_sequence(const std::string &value) {
+  return is_digits(value) && value.size() <= 10 &&
+         std::stoull(value) <= std::numeric_limits<uint32_t>::max();
+}
+
+int query(int argc, char **argv, const std::string &dbn_path) {
+  const bool by_sequence = cli::has_option(argc, argv, "sequence");
+  if (!by_sequence && !cli::has_option(argc, argv, "ts")) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const std::string sequence = cli::get_option(argc, argv, "sequence");
+  if (by_sequence && !is_sequence(sequence)) {
+    std::cerr << "--sequence needs a 32-bit sequence number, e.g. "
+                 "--sequence=1234"
+              << std::endl;
+    return 1;
+  }
+  const std::string ts = cli::get_option(argc, argv, "ts");
+  if (!by_sequence && ts.empty()) {
+    std::cerr << "--ts needs a value, e.g. --ts=14:31:07.123" << std::endl;
+    return 1;
+  }
+
+  Duration duration;
+  replay_index::Index index{replay_index::PathFor(dbn_path)};
+  DbnFileReader reader{dbn_path};
+
+  uint64_t target_ts = 0;
+  if (!by_sequence) {
+    try {
+      target_ts = parse_ts(ts, index.trailer().first_ts_event);
+    } catch (const std::logic_error &) {
+      // Not digits, not a time of day, or too large for 64 bits
+      std::cerr << "Invalid --ts: " << ts << std::endl;
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  const uint32_t target_sequence = by_sequence ? std::stoul(sequence) : 0;
+
+  const replay_index::Entry &entry = by_sequence
+                                         ? index.FindBySequence(target_sequence)
+                                         : index.FindByTsEvent(target_ts);
+
+  FlatMapOrderBook order_book;
+  const std::vector<char> data = index.ReadCheckpoint(entry);
+  order_book.LoadCheckpoint(checkpoint::Reader{data.data(), data.size()});
+
+  const ReplayPosition &position = order_book.Position();
+  auto reached = [&](const databento::MboMsg &next) {
+    if (by_sequence) {
+      return position.message_count > 0 &&
+             position.sequence >= target_sequence;
+    }
+    return next.hd.ts_event.time_since_epoch().count() > target_ts;
+  };
+
+  // Replay the delta between the checkpoint and the requested point
+  uint64_t replayed = 0;
+  reader.Seek(entry.dbn_offset);
+  while (const databento::Record *record = reader.NextRecord()) {
+    if (record->RType() != databento::RType::Mbo) {
+      continue;
+    }
+    const auto &msg = record->Get<databento::MboMsg>();
+    if (reached(msg)) {
+      break;
+    }
+    order_book.ProcessMboMsg(msg);
+    ++replayed;
+  }
+
+  std::cout << "{\n"
+            << "  \"message_count\": " << position.message_count << ",\n"
+            << "  \"sequence\": " << position.sequence << ",\n"
+            << "  \"ts_event\": " << position.ts_event << ",\n"
+            << "  \"ts_recv\": " << position.ts_recv << ",\n"
+            << "  \"levels\": [\n";
+  order_book.Snapshot(std::cout);
+  std::cout << "\n  ]\n}" << std::endl;
+
+  std::cerr << "Restored checkpoint at message "
+            << entry.position.message_count << " and replayed " << replayed
+            << " messages in " << duration.Millis() << " ms" << std::endl;
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const std::vector<std::string> args = cli::positional_args(argc, argv);
+  if (args.size() < 2) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const std::string &command = args[0];
+  const std::string &dbn_path = args[1];
+
+  if (command == "build") {
+    const uint64_t interval_messages =
+        std::stoull(cli::get_option(argc, argv, "every-messages",
+                                    std::to_string(kDefaultIntervalMessages)));
+    const uint64_t interval_ns =
+        std::stoull(cli::get_option(argc, argv, "every-ns", "0"));
+    return build(dbn_path, interval_messages, interval_ns);
+  }
+  if (command == "query") {
+    return query(argc, argv, dbn_path);
+  }
+
+  usage(argv[0]);
+  return 1;
+}
@@ -0,0 +1,80 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "SharedBook.h"
+#include "cli.h"
+
+namespace {
+
+void usage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " <shm name> [--instrument=ID] [--poll-us=N] [--count=N]"
+            << std::endl;
+}
+
+void print(uint32_t instrument_id, const TopOfBook &top) {
+  std::cout << "{\"instrument_id\": " << instrument_id
+            << ", \"sequence\": " << top.position.sequence
+            << ", \"ts_recv\": " << top.position.ts_recv
+            << ", \"bid\": " << top.best_bid << ", \"ask\": " << top.best_ask
+            << ", \"bid_size\": "
+            << (top.bid_depth > 0 ? top.bids[0].quantity : 0)
+            << ", \"ask_size\": "
+            << (top.ask_depth > 0 ? top.asks[0].quantity : 0) << "}\n";
+}
+
+} // namespace
+
+// Polls a segment written by `json_generator --shm=<name>` and prints a line
+// whenever an instrument's top of book changes
+int main(int argc, char **argv) {
+  const std::vector<std::string> args = cli::positional_args(argc, argv);
+  if (args.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const std::string instrument = cli::get_option(argc, argv, "instrument");
+  const auto poll = std::chrono::microseconds(
+      std::stoull(cli::get_option(argc, argv, "poll-us", "100")));
+  const uint64_t count = std::stoull(cli::get_option(argc, argv, "count", "0"));
+
+  shared_book::Reader reader(args.front());
+  std::unordered_map<uint32_t, uint64_t> seen_versions;
+  uint64_t printed = 0;
+  TopOfBook top;
+
+  while (count == 0 || printed < count) {
+    std::vector<uint32_t> instruments;
+    if (instrument.empty()) {
+      instruments = reader.Instruments();
+    } else {
+      instruments.push_back(std::stoul(instrument));
+    }
+
+    bool changed = false;
+    for (uint32_t instrument_id : instruments) {
+      const uint64_t version = reader.Version(instrument_id);
+      uint64_t &seen = seen_versions[instrument_id];
+      if (version != seen && reader.Read(instrument_id, top)) {
+        seen = version;
+        print(instrument_id, top);
+        changed = true;
+        if (++printed == count) {
+          break;
+        }
+      }
+    }
+    if (!changed) {
+      std::this_thread::sleep_for(poll);
+    }
+  }
+
+  std::cout.flush();
+  return 0;
+}
@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <array>
+#include <barrier>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CustomAllocationMapOrderBook.h"
+#include "FlatMapOrderBook.h"
+#include "MessageCache.h"
+#include "OrderBook.h"
+#include "cli.h"
+
+// Messages each book applies between comparisons
+constexpr size_t kChunkSize = 4096;
+
+constexpr size_t kLanes = 3;
+constexpr std::array<const char *, kLanes> kLaneNames = {
+    "OrderBook", "FlatMapOrderBook", "CustomAllocationMapOrderBook"};
+
+// State shared by the lanes, one thread per book implementation. Each lane
+// records its StateHash() after every message of the current chunk, then
+// waits at the barrier while CompareChunk checks that they all agree.
+struct Lockstep {
+  explicit Lockstep(const message_cache::View &messages)
+      : msgs{messages}, chunk_end{std::min(kChunkSize, messages.size())},
+        done{messages.empty()} {
+    for (auto &lane_hashes : hashes) {
+      lane_hashes.resize(kChunkSize);
+    }
+  }
+
+  // Runs on one lane while the others wait, so it needs no locking
+  void CompareChunk() noexcept {
+    for (const auto &error : errors) {
+      if (error) {
+        done = true;
+        return;
+      }
+    }
+    for (size_t i = 0; i < chunk_end - chunk_begin; ++i) {
+      for (size_t lane = 1; lane < kLanes; ++lane) {
+        if (hashes[lane][i] != hashes[0][i]) {
+          divergence = chunk_begin + i;
+          done = true;
+          return;
+        }
+      }
+    }
+    chunk_begin = chunk_end;
+    chunk_end = std::min(chunk_begin + kChunkSize, msgs.size());
+    done = chunk_begin == msgs.size();
+  }
+
+  const message_cache::View &msgs;
+  std::array<std::vector<uint64_t>, kLanes> hashes;
+  std::array<std::exception_ptr, kLanes> errors;
+  size_t chunk_begin = 0;
+  size_t chunk_end;
+  bool done;
+  size_t divergence = SIZE_MAX;
+};
+
+struct CompareChunk {
+  Lockstep *lockstep;
+  void operator()() noexcept { lockstep->CompareChunk(); }
+};
+
+template <typename Book>
+void replay(Lockstep &lockstep, std::barrier<CompareChunk> &barrier,
+            size_t lane) {
+  typename Book::template WithFeatures<BookFeatures::StateHash> book;
+  std::vector<uint64_t> &hashes = lockstep.hashes[lane];
+  while (!lockstep.done) {
+    try {
+      for (size_t i = lockstep.chunk_begin; i < lockstep.chunk_end; ++i) {
+        book.ProcessMboMsg(lockstep.msgs[i]);
+        hashes[i - lockstep.chunk_begin] = book.StateHash();
+      }
+    } catch (...) {
+      lockstep.errors[lane] = std::current_exception();
+    }
+    barrier.arrive_and_wait();
+  }
+}
+
+// Returns false if the books diverged or one of them failed
+bool verify(const std::string &dbn_file_path) {
+  const message_cache::View msgs = message_cache::Open(dbn_file_path);
+  Lockstep lockstep{msgs};
+  std::barrier<CompareChunk> barrier{kLanes, CompareChunk{&lockstep}};
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> lanes;
+  lanes.emplace_back(replay<OrderBook>, std::ref(lockstep), std::ref(barrier),
+                     0);
+  lanes.emplace_back(replay<FlatMapOrderBook>, std::ref(lockstep),
+                     std::ref(barrier), 1);
+  lanes.emplace_back(replay<CustomAllocationMapOrderBook>, std::ref(lockstep),
+                     std::ref(barrier), 2);
+  for (auto &lane : lanes) {
+    lane.join();
+  }
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  std::cout << dbn_file_path << ": ";
+  for (size_t lane = 0; lane < kLanes; ++lane) {
+    if (lockstep.errors[lane]) {
+      try {
+        std::rethrow_exception(lockstep.errors[lane]);
+      } catch (const std::exception &e) {
+        std::cout << kLaneNames[lane] << " failed in messages "
+                  << lockstep.chunk_begin << " to " << lockstep.chunk_end
+                  << ": " << e.what() << std::endl;
+      }
+      return false;
+    }
+  }
+
+  if (lockstep.divergence != SIZE_MAX) {
+    const size_t i = lockstep.divergence;
+    const databento::MboMsg msg = msgs[i];
+    std::cout << "books diverge at message " << i << " (sequence "
+              << msg.sequence << ", ts_recv "
+              << msg.ts_recv.time_since_epoch().count() << ", action "
+              << static_cast<char>(msg.action) << ", order "
+              << msg.order_id << ")\n";
+    for (size_t lane = 0; lane < kLanes; ++lane) {
+      std::cout << "  " << kLaneNames[lane] << ": " << std::hex
+                << lockstep.hashes[lane][i - lockstep.chunk_begin]
+                << std::dec << "\n";
+    }
+    return false;
+  }
+
+  std::cout << "all " << kLanes << " books agree on " << msgs.size()
+            << " messages, final hash " << std::hex
+            << (msgs.empty() ? 0 : lockstep.hashes[0][(msgs.size() - 1) %
+                                                       kChunkSize])
+            << std::dec << " (" << msgs.size() / seconds << " msgs/s)"
+            << std::endl;
+  return true;
+}
+
+// Replays each file through every book implementation in lockstep and
+// compares their state hashes after every message
+int main(int argc, char **argv) {
+  bool ok = true;
+  for (const auto &dbn_file_path : cli::get_dbn_files(argc, argv)) {
+    ok = verify(dbn_file_path) && ok;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+#include "Analytics.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace analytics {
+
+Stage::Bucket &Stage::Bucket::operator+=(const Bucket &other) {
+  adds += other.adds;
+  cancels += other.cancels;
+  modifies += other.modifies;
+  trades += other.trades;
+  spread_nanos += other.spread_nanos;
+  quoted_nanos += other.quoted_nanos;
+  return *this;
+}
+
+Stage::Bucket &Stage::Bucket::operator-=(const Bucket &other) {
+  adds -= other.adds;
+  cancels -= other.cancels;
+  modifies -= other.modifies;
+  trades -= other.trades;
+  spread_nanos -= other.spread_nanos;
+  quoted_nanos -= other.quoted_nanos;
+  return *this;
+}
+
+Stage::Stage(const Config &config)
+    : top_levels_{config.top_levels}, window_nanos_{config.window_nanos},
+      bucket_nanos_{config.window_nanos / kBuckets} {
+  if (top_levels_ == 0 || top_levels_ > kPublishedDepth) {
+    throw std::invalid_argument("Imbalance needs 1 to " +
+                                std::to_string(kPublishedDepth) + " levels");
+  }
+  if (bucket_nanos_ == 0) {
+    throw std::invalid_argument("Analytics window is too short");
+  }
+}
+
+const Sample &Stage::Update(const databento::MboMsg &msg,
+                            const TopOfBook &top) {
+  const uint64_t ts = msg.ts_recv.time_since_epoch().count();
+  if (!started_) {
+    started_ = true;
+    now_ = ts;
+  }
+  Advance(ts);
+
+  Bucket &bucket = buckets_[now_ / bucket_nanos_ % kBuckets];
+  Bucket counted;
+  switch (msg.action) {
+  case 'A':
+    counted.adds = 1;
+    break;
+  case 'C':
+    counted.cancels = 1;
+    break;
+  case 'M':
+    counted.modifies = 1;
+    break;
+  case 'T':
+    // An 'F' repeats a 'T' from the resting side, so only 'T' is counted
+    counted.trades = 1;
+    break;
+  default:
+    break;
+  }
+  bucket += counted;
+  window_ += counted;
+
+  UpdateLevels(top.bids, bids_, bid_quantity_);
+  UpdateLevels(top.asks, asks_, ask_quantity_);
+  const bool quoted = top.best_bid != 0 && top.best_ask != 0;
+  spread_ = quoted ? top.best_ask - top.best_bid : 0;
+
+  sample_.ts_recv = ts;
+  sample_.instrument_id = msg.hd.instrument_id;
+  sample_.best_bid = top.best_bid;
+  sample_.best_ask = top.best_ask;
+  const double best_sizes =
+      static_cast<double>(top.bids[0].quantity) + top.asks[0].quantity;
+  sample_.microprice =
+      quoted ? (static_cast<double>(top.best_bid) * top.asks[0].quantity +
+                static_cast<double>(top.best_ask) * top.bids[0].quantity) /
+                   best_sizes
+             : 0;
+  const int64_t top_quantity = bid_quantity_ + ask_quantity_;
+  sample_.imbalance =
+      top_quantity > 0
+          ? static_cast<float>(bid_quantity_ - ask_quantity_) / top_quantity
+          : 0;
+  sample_.time_weighted_spread =
+      window_.quoted_nanos > 0 ? window_.spread_nanos / window_.quoted_nanos
+                               : static_cast<double>(spread_);
+  sample_.adds = window_.adds;
+  sample_.cancels = window_.cancels;
+  sample_.modifies = window_.modifies;
+  sample_.trades = window_.trades;
+  return sample_;
+}
+
+void Stage::Advance(uint64_t ts) {
+  if (ts <= now_) {
+    return;
+  }
+  if (ts - now_ >= window_nanos_) {
+    // Everything in the window is older than the gap, so start over with
+    // the last spread held for the whole of it
+    buckets_.fill(Bucket{});
+    window_ = Bucket{};
+    now_ = (ts - window_nanos_) / bucket_nanos_ * bucket_nanos_;
+  }
+  while (now_ < ts) {
+    const uint64_t bucket_end = (now_ / bucket_nanos_ + 1) * bucket_nanos_;
+    const uint64_t until = std::min(ts, bucket_end);
+    if (spread_ != 0) {
+      Bucket held;
+      held.quoted_nanos = until - now_;
+      held.spread_nanos = static_cast<double>(spread_) * held.quoted_nanos;
+      buckets_[now_ / bucket_nanos_ % kBuckets] += held;
+      window_ += held;
+    }
+    now_ = until;
+    if (now_ == bucket_end) {
+      // The bucket now_ enters last held the oldest slice of the window
+      Bucket &expired = buckets_[now_ / bucket_nanos_ % kBuckets];
+      window_ -= expired;
+      expired = Bucket{};
+    }
+  }
+}
+
+void Stage::UpdateLevels(const PublishedLevel (&levels)[kPublishedDepth],
+                         std::array<PublishedLevel, kPublishedDepth> &previous,
+                         int64_t &total) {
+  for (uint32_t i = 0; i < top_levels_; ++i) {
+    if (levels[i].quantity != previous[i].quantity) {
+      total += static_cast<int64_t>(levels[i].quantity) -
+               static_cast<int64_t>(previous[i].quantity);
+      previous[i] = levels[i];
+    }
+  }
+}
+
+Writer::Writer(const std::string &path, const Config &config)
+    : path_{path}, out_{path, std::ios::binary | std::ios::trunc} {
+  if (!out_) {
+    throw std::runtime_error("Could not open analytics file for writing: " +
+                             path);
+  }
+  Header header;
+  header.top_levels = config.top_levels;
+  header.sample_size = sizeof(Sample);
+  header.window_nanos = config.window_nanos;
+  out_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  buffer_.reserve(kBufferSamples);
+}
+
+Writer::~Writer() {
+  // Best effort; call Flush() to find out whether the write failed
+  out_.write(reinterpret_cast<const char *>(buffer_.data()),
+             buffer_.size() * sizeof(Sample));
+}
+
+void Writer::Write(const Sample &sample) {
+  if (buffer_.size() == kBufferSamples) {
+    Flush();
+  }
+  buffer_.push_back(sample);
+}
+
+void Writer::Flush() {
+  out_.write(reinterpret_cast<const char *>(buffer_.data()),
+             buffer_.size() * sizeof(Sample));
+  out_.flush();
+  if (!out_) {
+    throw std::runtime_error("Failed writing analytics file: " + path_);
+  }
+  buffer_.clear();
+}
+
+std::vector<Sample> Read(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Could not open analytics file: " + path);
+  }
+  Header header;
+  in.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (!in || header.magic != kMagic) {
+    throw std::runtime_error("Not an analytics file: " + path);
+  }
+  if (header.version != kVersion || header.sample_size != sizeof(Sample)) {
+    throw std::runtime_error("Unsupported analytics file version: " + path);
+  }
+  std::vector<Sample> samples;
+  Sample sample;
+  while (in.read(reinterpret_cast<char *>(&sample), sizeof(sample))) {
+    samples.push_back(sample);
+  }
+  return samples;
+}
+
+} // namespace analytics
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "databento/record.hpp"
+
+#include "Order.h"
+#include "TopOfBook.h"
+
+// Microstructure statistics computed after every message, written as a
+// binary time series instead of being recomputed from JSON snapshots.
+//
+// File layout (native endianness): Header, then one Sample per message.
+namespace analytics {
+
+constexpr uint32_t kMagic = 0x4154534d; // "MSTA"
+constexpr uint32_t kVersion = 1;
+
+struct Config {
+  uint32_t top_levels = 5; // Levels per side in the imbalance
+  uint64_t window_nanos = 1000000000; // For the rates and the spread average
+};
+
+struct Header {
+  uint32_t magic = kMagic;
+  uint32_t version = kVersion;
+  uint32_t top_levels = 0;
+  uint32_t sample_size = 0;
+  uint64_t window_nanos = 0;
+};
+
+struct Sample {
+  uint64_t ts_recv;
+  Price best_bid; // 0 for an empty side
+  Price best_ask;
+  double microprice; // Best prices weighted by the opposite side's size
+  double time_weighted_spread; // Over the window, while both sides quoted
+  float imbalance; // (bid - ask) / (bid + ask) over the top levels
+  uint32_t instrument_id;
+  // Messages by action over the window. Trades count 'T' messages only,
+  // since each 'F' repeats one
+  uint32_t adds;
+  uint32_t cancels;
+  uint32_t modifies;
+  uint32_t trades;
+};
+
+// Keeps one book's statistics up to date from the top of book it publishes
+// after each message. The top-level sums are adjusted only for the levels
+// that changed, and the window is a ring of buckets with running totals,
+// so an update costs the same however deep the book or busy the window.
+class Stage {
+public:
+  static constexpr size_t kBuckets = 64;
+
+  explicit Stage(const Config &config = {});
+
+  // Call after the book has processed msg. The book must publish its top
+  // of book (BookFeatures::PublishTop).
+  template <typename Book>
+  const Sample &Update(const databento::MboMsg &msg, const Book &book) {
+    return Update(msg, book.Published().Load());
+  }
+  const Sample &Update(const databento::MboMsg &msg, const TopOfBook &top);
+
+private:
+  struct Bucket {
+    uint32_t adds = 0;
+    uint32_t cancels = 0;
+    uint32_t modifies = 0;
+    uint32_t trades = 0;
+    double spread_nanos = 0; // Spread times the time it was quoted
+    uint64_t quoted_nanos = 0;
+    Bucket &operator+=(const Bucket &other);
+    Bucket &operator-=(const Bucket &other);
+  };
+
+  // Moves the clock to ts, crediting the spread held since the last message
+  // to the buckets it spans and expiring those that leave the window
+  void Advance(uint64_t ts);
+  void UpdateLevels(const PublishedLevel (&levels)[kPublishedDepth],
+                    std::array<PublishedLevel, kPublishedDepth> &previous,
+                    int64_t &total);
+
+  uint32_t top_levels_;
+  uint64_t window_nanos_;
+  uint64_t bucket_nanos_;
+
+  bool started_ = false;
+  uint64_t now_ = 0;
+  Price spread_ = 0; // 0 while a side is empty
+  std::array<Bucket, kBuckets> buckets_;
+  Bucket window_;
+
+  std::array<PublishedLevel, kPublishedDepth> bids_{};
+  std::array<PublishedLevel, kPublishedDepth> asks_{};
+  int64_t bid_quantity_ = 0;
+  int64_t ask_quantity_ = 0;
+
+  Sample sample_{};
+};
+
+// Appends samples to a file through a buffer
+class Writer {
+public:
+  static constexpr size_t kBufferSamples = 16384;
+
+  Writer(const std::string &path, const Config &config);
+  ~Writer();
+
+  void Write(const Sample &sample);
+  void Flush();
+
+private:
+  std::string path_;
+  std::ofstream out_;
+  std::vector<Sample> buffer_;
+};
+
+std::vector<Sample> Read(const std::string &path);
+
+} // namespace analytics
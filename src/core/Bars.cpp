@@ -0,0 +1,133 @@
+#include "Bars.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace bars {
+
+namespace {
+
+template <typename T>
+void AppendColumn(std::vector<char> &out, const std::vector<Bar> &block,
+                  T Bar::*field) {
+  const size_t offset = out.size();
+  out.resize(offset + block.size() * sizeof(T));
+  char *dest = out.data() + offset;
+  for (const Bar &bar : block) {
+    std::memcpy(dest, &(bar.*field), sizeof(T));
+    dest += sizeof(T);
+  }
+}
+
+template <typename T>
+void ReadColumn(std::ifstream &in, std::vector<char> &scratch, Bar *block,
+                size_t count, T Bar::*field) {
+  scratch.resize(count * sizeof(T));
+  if (!in.read(scratch.data(), scratch.size())) {
+    throw std::runtime_error("Bar file truncated");
+  }
+  for (size_t i = 0; i < count; ++i) {
+    std::memcpy(&(block[i].*field), scratch.data() + i * sizeof(T),
+                sizeof(T));
+  }
+}
+
+// Applies f to every column in file order
+template <typename F> void ForEachColumn(F &&f) {
+  f(&Bar::first_ts);
+  f(&Bar::last_ts);
+  f(&Bar::open);
+  f(&Bar::high);
+  f(&Bar::low);
+  f(&Bar::close);
+  f(&Bar::volume);
+  f(&Bar::vwap);
+  f(&Bar::trades);
+  f(&Bar::instrument_id);
+}
+
+} // namespace
+
+BarType ParseBarType(const std::string &name) {
+  if (name == "time")
+    return BarType::Time;
+  if (name == "volume")
+    return BarType::Volume;
+  if (name == "tick")
+    return BarType::Tick;
+  throw std::invalid_argument("Invalid bar type: " + name);
+}
+
+Writer::Writer(const std::string &path, const Config &config)
+    : path_{path}, out_{path, std::ios::binary | std::ios::trunc} {
+  if (!out_) {
+    throw std::runtime_error("Could not open bar file for writing: " + path);
+  }
+  Header header;
+  header.type = config.type;
+  header.interval = config.interval;
+  out_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  block_.reserve(kBlockBars);
+  columns_.reserve(kBlockBars * sizeof(Bar) + sizeof(uint64_t));
+}
+
+Writer::~Writer() {
+  // Best effort; call Flush() to find out whether the write failed
+  if (!block_.empty()) {
+    try {
+      Flush();
+    } catch (...) {
+    }
+  }
+}
+
+void Writer::Write(const Bar &bar) {
+  block_.push_back(bar);
+  if (block_.size() == kBlockBars) {
+    Flush();
+  }
+}
+
+void Writer::Flush() {
+  if (!block_.empty()) {
+    const uint64_t count = block_.size();
+    columns_.assign(reinterpret_cast<const char *>(&count),
+                    reinterpret_cast<const char *>(&count + 1));
+    ForEachColumn([&](auto field) { AppendColumn(columns_, block_, field); });
+    out_.write(columns_.data(), columns_.size());
+    block_.clear();
+  }
+  out_.flush();
+  if (!out_) {
+    throw std::runtime_error("Failed writing bar file: " + path_);
+  }
+}
+
+std::vector<Bar> Read(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Could not open bar file: " + path);
+  }
+  Header header;
+  in.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (!in || header.magic != kMagic) {
+    throw std::runtime_error("Not a bar file: " + path);
+  }
+  if (header.version != kVersion) {
+    throw std::runtime_error("Unsupported bar file version: " + path);
+  }
+
+  std::vector<Bar> bars;
+  std::vector<char> scratch;
+  uint64_t count;
+  while (in.read(reinterpret_cast<char *>(&count), sizeof(count))) {
+    const size_t first = bars.size();
+    bars.resize(first + count);
+    ForEachColumn([&](auto field) {
+      ReadColumn(in, scratch, bars.data() + first, count, field);
+    });
+  }
+  return bars;
+}
+
+} // namespace bars
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Order.h"
+
+// OHLCV bars built from trades as they are replayed, so bars come out of
+// the same pass that rebuilds the books.
+//
+// File layout (native endianness): Header, then blocks of up to
+// Writer::kBlockBars bars, each a uint64_t count followed by one array per
+// column in the order first_ts, last_ts, open, high, low, close, volume,
+// vwap, trades, instrument_id.
+namespace bars {
+
+constexpr uint32_t kMagic = 0x53524142; // "BARS"
+constexpr uint32_t kVersion = 1;
+
+enum class BarType : uint32_t { Time, Volume, Tick };
+
+BarType ParseBarType(const std::string &name);
+
+struct Config {
+  BarType type = BarType::Time;
+  uint64_t interval = 60000000000; // Nanoseconds, shares or trades
+};
+
+struct Header {
+  uint32_t magic = kMagic;
+  uint32_t version = kVersion;
+  BarType type = BarType::Time;
+  uint32_t reserved = 0;
+  uint64_t interval = 0;
+};
+
+struct Bar {
+  uint64_t first_ts; // ts_event of the first and last trade
+  uint64_t last_ts;
+  Price open;
+  Price high;
+  Price low;
+  Price close;
+  uint64_t volume;
+  double vwap;
+  uint32_t trades;
+  uint32_t instrument_id;
+};
+
+// One instrument's bar in progress. The state is a single Bar, so adding a
+// trade never allocates; completed bars go to the caller's emit(const
+// Bar &). Time bars are aligned to multiples of the interval since the
+// epoch and close on the first trade of a later one. Volume bars close at
+// exactly interval shares, splitting the trade that crosses the boundary
+// between the two bars. Tick bars close after interval trades.
+class Builder {
+public:
+  Builder(uint32_t instrument_id, const Config &config)
+      : config_{config}, instrument_id_{instrument_id} {
+    config_.interval = std::max<uint64_t>(config_.interval, 1);
+  }
+
+  template <typename Emit>
+  void AddTrade(uint64_t ts, Price price, uint64_t quantity, Emit &&emit) {
+    if (quantity == 0) {
+      return;
+    }
+    switch (config_.type) {
+    case BarType::Time: {
+      const uint64_t start = ts / config_.interval * config_.interval;
+      if (open_ && start > bar_start_) {
+        Close(emit);
+      }
+      if (!open_) {
+        bar_start_ = start;
+      }
+      Append(ts, price, quantity);
+      break;
+    }
+    case BarType::Volume:
+      while (quantity > 0) {
+        const uint64_t taken =
+            std::min(quantity, config_.interval - (open_ ? bar_.volume : 0));
+        Append(ts, price, taken);
+        quantity -= taken;
+        if (bar_.volume == config_.interval) {
+          Close(emit);
+        }
+      }
+      break;
+    case BarType::Tick:
+      Append(ts, price, quantity);
+      if (bar_.trades == config_.interval) {
+        Close(emit);
+      }
+      break;
+    }
+  }
+
+  // Emits the bar in progress, if any
+  template <typename Emit> void Flush(Emit &&emit) {
+    if (open_) {
+      Close(emit);
+    }
+  }
+
+private:
+  void Append(uint64_t ts, Price price, uint64_t quantity) {
+    if (!open_) {
+      open_ = true;
+      bar_ = Bar{ts, ts, price, price, price, price, 0, 0, 0, instrument_id_};
+      notional_ = 0;
+    }
+    bar_.last_ts = ts;
+    bar_.high = std::max(bar_.high, price);
+    bar_.low = std::min(bar_.low, price);
+    bar_.close = price;
+    bar_.volume += quantity;
+    ++bar_.trades;
+    notional_ += static_cast<double>(price) * static_cast<double>(quantity);
+  }
+
+  template <typename Emit> void Close(Emit &emit) {
+    bar_.vwap = notional_ / static_cast<double>(bar_.volume);
+    open_ = false;
+    emit(static_cast<const Bar &>(bar_));
+  }
+
+  Config config_;
+  uint32_t instrument_id_;
+  bool open_ = false;
+  uint64_t bar_start_ = 0;
+  double notional_ = 0;
+  Bar bar_{};
+};
+
+// Writes bars to a file in column blocks
+class Writer {
+public:
+  static constexpr size_t kBlockBars = 4096;
+
+  Writer(const std::string &path, const Config &config);
+  ~Writer();
+
+  void Write(const Bar &bar);
+  void Flush();
+
+private:
+  std::string path_;
+  std::ofstream out_;
+  std::vector<Bar> block_;
+  std::vector<char> columns_;
+};
+
+std::vector<Bar> Read(const std::string &path);
+
+} // namespace bars
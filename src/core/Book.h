@@ -0,0 +1,687 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "BookEvents.h"
+#include "BookFeatures.h"
+#include "BookUtils.h"
+#include "Checkpoint.h"
+#include "DepthLadder.h"
+#include "ObjectPool.h"
+#include "Order.h"
+#include "SeqLock.h"
+#include "TopOfBook.h"
+#include "ZobristHash.h"
+#include "databento/record.hpp"
+
+// An order book over the level and order containers chosen by Containers,
+// which provides:
+//   BidBook, AskBook  price -> OrderList * maps, best price first
+//   OrderMap          order id -> Order * map
+//   Arena             whatever the containers allocate from, constructed
+//                     before them and destroyed after them
+//   Make<C>(arena)    a container C that allocates from arena
+// Everything else, from the matching to the checkpoints, is shared by
+// every book. Features picks the optional per-message work (see
+// BookFeatures.h).
+template <typename Containers, BookEventSink EventSink = NullEventSink,
+          BookFeatures Features = BookFeatures::None>
+class BasicBook {
+public:
+  // This book with more optional features switched on
+  template <BookFeatures More>
+  using WithFeatures = BasicBook<Containers, EventSink, Features | More>;
+
+  // Orders and levels the pools hold before they first grow: enough for a
+  // whole replay, or a few pages for one book among many, e.g. one per
+  // instrument
+  static constexpr size_t kDefaultPoolSize = 100000;
+  static constexpr size_t kInstrumentPoolSize = 1024;
+
+  explicit BasicBook(EventSink event_sink = EventSink{},
+                     MatchMode mode = MatchMode::CrossLocally,
+                     size_t pool_size = kDefaultPoolSize);
+  explicit BasicBook(MatchMode mode, size_t pool_size = kDefaultPoolSize)
+      : BasicBook(EventSink{}, mode, pool_size) {}
+
+  void ProcessMboMsg(const databento::MboMsg &msg);
+
+  void AddOrder(const databento::MboMsg &msg);
+  void ModifyOrder(const databento::MboMsg &msg);
+  void CancelOrder(const databento::MboMsg &msg);
+  void CancelOrderById(OrderId order_id);
+  void TradeOrder(const databento::MboMsg &msg);
+
+  Price GetBestBid() const;
+  Price GetBestAsk() const;
+
+  // Orders and quantity ahead of an order at its level, in O(log n), or
+  // nullopt if the order is not on the book
+  std::optional<uint32_t> GetQueuePosition(OrderId order_id) const
+    requires(Has(Features, BookFeatures::QueuePositions));
+  std::optional<uint64_t> GetQuantityAhead(OrderId order_id) const
+    requires(Has(Features, BookFeatures::QueuePositions));
+
+  // Quantity resting on side at price or better, and the cost of sweeping
+  // quantity from side's best level outward, e.g. side 'A' for a buy. Both
+  // take O(log n) in the levels near the touch.
+  uint64_t QuantityToPrice(char side, Price price) const
+    requires(Has(Features, BookFeatures::DepthQueries));
+  SweepCost CostToFill(char side, uint64_t quantity) const
+    requires(Has(Features, BookFeatures::DepthQueries));
+
+  void Snapshot(std::ostream &os) const;
+
+  // Position of the last message passed to ProcessMboMsg
+  const ReplayPosition &Position() const { return position; }
+
+  checkpoint::Writer CreateCheckpoint() const;
+  void SaveCheckpoint(const std::string &path) const;
+  void LoadCheckpoint(const std::string &path);
+  void LoadCheckpoint(const checkpoint::Reader &reader);
+
+  // Releases every order and level back to the pools
+  void Clear();
+
+  EventSink &Events() { return sink; }
+
+  // Top of book as of the last message, republished after every message.
+  // Any thread may Load() it while this book keeps processing.
+  const SeqLock<TopOfBook> &Published() const
+    requires(Has(Features, BookFeatures::PublishTop))
+  {
+    return published;
+  }
+
+  // Hash of every resting order and its place in the queue, updated as the
+  // book changes. Books holding the same state have the same hash.
+  uint64_t StateHash() const
+    requires(Has(Features, BookFeatures::StateHash))
+  {
+    return state_hash.value();
+  }
+
+private:
+  using BidBook = typename Containers::BidBook;
+  using AskBook = typename Containers::AskBook;
+  using OrderMap = typename Containers::OrderMap;
+
+  static constexpr bool kHashesState = Has(Features, BookFeatures::StateHash);
+  static constexpr bool kIndexesQueues =
+      Has(Features, BookFeatures::QueuePositions);
+  static constexpr bool kTracksDepth =
+      Has(Features, BookFeatures::DepthQueries);
+
+  // Routines compiled once per side, so that the container, its comparator
+  // and the depth ladder are chosen at compile time. ProcessMboMsg picks
+  // the side once per message; cancels pick it from the order they find.
+  template <databento::Side S> void Apply(const databento::MboMsg &msg);
+  template <databento::Side S> void AddOrder(const databento::MboMsg &msg);
+  template <databento::Side S> void DeleteOrder(Order *order);
+  template <databento::Side S>
+  void AppendOrder(OrderList *list, Order *order);
+  template <databento::Side S> void RemoveOrder(Order *order);
+  template <databento::Side S> bool Crosses(Price price) const;
+
+  template <databento::Side S> auto &Levels() {
+    if constexpr (S == databento::Side::Bid) {
+      return bids;
+    } else {
+      return asks;
+    }
+  }
+  template <databento::Side S>
+  DepthLadder &Depth()
+    requires(kTracksDepth)
+  {
+    if constexpr (S == databento::Side::Bid) {
+      return bid_depth;
+    } else {
+      return ask_depth;
+    }
+  }
+
+  DepthLadder &Depth(char side)
+    requires(kTracksDepth)
+  {
+    return side == 'B' ? bid_depth : ask_depth;
+  }
+  const DepthLadder &Depth(char side) const
+    requires(kTracksDepth)
+  {
+    return side == 'B' ? bid_depth : ask_depth;
+  }
+
+  void Match(char aggressor_side);
+  void Publish();
+
+  // Declared ahead of the containers so they are destroyed first
+  [[no_unique_address]] typename Containers::Arena arena;
+  BidBook bids{Containers::template Make<BidBook>(arena)};
+  AskBook asks{Containers::template Make<AskBook>(arena)};
+  OrderMap orders{Containers::template Make<OrderMap>(arena)};
+
+  ObjectPool<Order> order_pool;
+  ObjectPool<OrderList> list_pool;
+
+  ReplayPosition position;
+
+  [[no_unique_address]] EventSink sink;
+  MatchMode match_mode;
+
+  [[no_unique_address]] FeatureState<Features, BookFeatures::PublishTop,
+                                     SeqLock<TopOfBook>> published;
+
+  [[no_unique_address]] FeatureState<Features, BookFeatures::StateHash,
+                                     ZobristHash> state_hash;
+  using Ladder = FeatureState<Features, BookFeatures::DepthQueries,
+                              DepthLadder>;
+  [[no_unique_address]] Ladder bid_depth{'B'};
+  [[no_unique_address]] Ladder ask_depth{'A'};
+};
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+BasicBook<Containers, EventSink, Features>::BasicBook(EventSink event_sink,
+                                                      MatchMode mode,
+                                                      size_t pool_size)
+    : order_pool{pool_size}, list_pool{pool_size},
+      sink{std::move(event_sink)}, match_mode{mode} {}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+Price BasicBook<Containers, EventSink, Features>::GetBestBid() const {
+  return book_utils::GetBest(bids);
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+Price BasicBook<Containers, EventSink, Features>::GetBestAsk() const {
+  return book_utils::GetBest(asks);
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+std::optional<uint32_t>
+BasicBook<Containers, EventSink, Features>::GetQueuePosition(
+    OrderId order_id) const
+  requires(Has(Features, BookFeatures::QueuePositions))
+{
+  auto it = orders.find(order_id);
+  if (it == orders.end()) {
+    return std::nullopt;
+  }
+  return static_cast<uint32_t>(book_utils::Ahead(it->second).count);
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+std::optional<uint64_t>
+BasicBook<Containers, EventSink, Features>::GetQuantityAhead(
+    OrderId order_id) const
+  requires(Has(Features, BookFeatures::QueuePositions))
+{
+  auto it = orders.find(order_id);
+  if (it == orders.end()) {
+    return std::nullopt;
+  }
+  return static_cast<uint64_t>(book_utils::Ahead(it->second).quantity);
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+uint64_t BasicBook<Containers, EventSink, Features>::QuantityToPrice(
+    char side, Price price) const
+  requires(Has(Features, BookFeatures::DepthQueries))
+{
+  return Depth(side).QuantityTo(price);
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+SweepCost BasicBook<Containers, EventSink, Features>::CostToFill(
+    char side, uint64_t quantity) const
+  requires(Has(Features, BookFeatures::DepthQueries))
+{
+  return Depth(side).CostToFill(quantity);
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+void BasicBook<Containers, EventSink, Features>::ProcessMboMsg(
+    const databento::MboMsg &msg) {
+  // The touch is only compared around the message for a sink that listens
+  constexpr bool kReportsBbo = !std::is_same_v<EventSink, NullEventSink>;
+  Price best_bid = 0;
+  Price best_ask = 0;
+  if constexpr (kReportsBbo) {
+    best_bid = GetBestBid();
+    best_ask = GetBestAsk();
+  }
+
+  if (msg.side == 'B') {
+    Apply<databento::Side::Bid>(msg);
+  } else {
+    Apply<databento::Side::Ask>(msg);
+  }
+
+  if constexpr (kReportsBbo) {
+    if (GetBestBid() != best_bid || GetBestAsk() != best_ask) {
+      sink.OnBboChanged(BboEvent{GetBestBid(), GetBestAsk()});
+    }
+  }
+
+  ++position.message_count;
+  position.sequence = msg.sequence;
+  position.ts_event = msg.hd.ts_event.time_since_epoch().count();
+  position.ts_recv = msg.ts_recv.time_since_epoch().count();
+
+  Publish();
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+template <databento::Side S>
+void BasicBook<Containers, EventSink, Features>::Apply(
+    const databento::MboMsg &msg) {
+  switch (msg.action) {
+  case 'A':
+    AddOrder<S>(msg);
+    break;
+  case 'C':
+    CancelOrder(msg);
+    break;
+  case 'M':
+    CancelOrderById(msg.order_id);
+    AddOrder<S>(msg);
+    break;
+  case 'T':
+    TradeOrder(msg);
+    break;
+  case 'F':
+    CancelOrder(msg);
+    break;
+  default:
+    break;
+  }
+  // The book was uncrossed before this message, so only an add or modify
+  // reaching the opposite touch can have crossed it
+  if (match_mode == MatchMode::CrossLocally &&
+      (msg.action == 'A' || msg.action == 'M') && Crosses<S>(msg.price)) {
+    Match(msg.side);
+  }
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+void BasicBook<Containers, EventSink, Features>::AddOrder(
+    const databento::MboMsg &msg) {
+  if (msg.side == 'B') {
+    AddOrder<databento::Side::Bid>(msg);
+  } else {
+    AddOrder<databento::Side::Ask>(msg);
+  }
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+template <databento::Side S>
+void BasicBook<Containers, EventSink, Features>::AddOrder(
+    const databento::MboMsg &msg) {
+  Order *order = order_pool.acquire();
+  order->order_id = msg.order_id;
+  order->price = msg.price;
+  order->quantity = msg.size;
+  order->side = msg.side;
+  order->next = nullptr;
+  order->prev = nullptr;
+
+  auto &levels = Levels<S>();
+  auto it = levels.find(msg.price);
+  if (it != levels.end()) {
+    AppendOrder<S>(it->second, order);
+  } else {
+    OrderList *new_list = list_pool.acquire();
+    new_list->head = nullptr;
+    new_list->tail = nullptr;
+    new_list->total_quantity = 0;
+    new_list->order_count = 0;
+    levels.emplace(msg.price, new_list);
+    AppendOrder<S>(new_list, order);
+    sink.OnLevelAdded(LevelEvent{static_cast<char>(S), msg.price});
+  }
+  orders[order->order_id] = order;
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+void BasicBook<Containers, EventSink, Features>::CancelOrder(
+    const databento::MboMsg &msg) {
+  CancelOrderById(msg.order_id);
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+void BasicBook<Containers, EventSink, Features>::CancelOrderById(
+    OrderId order_id) {
+  auto map_it = orders.find(order_id);
+  if (map_it == orders.end()) {
+    return;
+  }
+
+  Order *order = map_it->second;
+  orders.erase(map_it);
+  if (order->side == 'B') {
+    DeleteOrder<databento::Side::Bid>(order);
+  } else {
+    DeleteOrder<databento::Side::Ask>(order);
+  }
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+template <databento::Side S>
+void BasicBook<Containers, EventSink, Features>::DeleteOrder(Order *order) {
+  RemoveOrder<S>(order);
+
+  // If the list is now empty, remove the price level
+  if (order->list->head == nullptr) {
+    Levels<S>().erase(order->price);
+    list_pool.release(order->list);
+    sink.OnLevelRemoved(LevelEvent{order->side, order->price});
+  }
+
+  order_pool.release(order);
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+void BasicBook<Containers, EventSink, Features>::ModifyOrder(
+    const databento::MboMsg &msg) {
+  CancelOrderById(msg.order_id);
+  AddOrder(msg);
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+void BasicBook<Containers, EventSink, Features>::TradeOrder(
+    const databento::MboMsg &msg) {
+  auto map_it = orders.find(msg.order_id);
+  if (map_it == orders.end()) {
+    return;
+  }
+
+  Order *order = map_it->second;
+  if (msg.size >= order->quantity) {
+    CancelOrderById(msg.order_id);
+  } else {
+    if constexpr (kHashesState) {
+      state_hash.OnQuantityChange(order, order->quantity - msg.size);
+    }
+    if constexpr (kIndexesQueues) {
+      book_utils::ReduceSlot(order->list, order, msg.size);
+    }
+    if constexpr (kTracksDepth) {
+      Depth(order->side).Add(order->price, -int64_t{msg.size});
+    }
+    order->quantity -= msg.size;
+    order->list->total_quantity -= msg.size;
+  }
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+template <databento::Side S>
+void BasicBook<Containers, EventSink, Features>::AppendOrder(OrderList *list,
+                                                             Order *order) {
+  if constexpr (kIndexesQueues) {
+    book_utils::EnqueueSlot(list, order);
+  }
+  order->list = list;
+  ++list->order_count;
+  list->total_quantity += order->quantity;
+  if (list->tail == nullptr) {
+    list->head = order;
+    list->tail = order;
+  } else {
+    list->tail->next = order;
+    order->prev = list->tail;
+    list->tail = order;
+  }
+  if constexpr (kHashesState) {
+    state_hash.OnAppend(order);
+  }
+  if constexpr (kTracksDepth) {
+    Depth<S>().Add(order->price, order->quantity);
+  }
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+template <databento::Side S>
+void BasicBook<Containers, EventSink, Features>::RemoveOrder(Order *order) {
+  if constexpr (kHashesState) {
+    state_hash.OnRemove(order);
+  }
+  if constexpr (kIndexesQueues) {
+    book_utils::DequeueSlot(order->list, order);
+  }
+  if constexpr (kTracksDepth) {
+    Depth<S>().Add(order->price, -int64_t{order->quantity});
+  }
+  --order->list->order_count;
+  order->list->total_quantity -= order->quantity;
+
+  if (order->prev) {
+    order->prev->next = order->next;
+  } else {
+    order->list->head = order->next;
+  }
+
+  if (order->next) {
+    order->next->prev = order->prev;
+  } else {
+    order->list->tail = order->prev;
+  }
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+template <databento::Side S>
+bool BasicBook<Containers, EventSink, Features>::Crosses(Price price) const {
+  if constexpr (S == databento::Side::Bid) {
+    return !asks.empty() && price >= asks.begin()->first;
+  } else {
+    return !bids.empty() && price <= bids.begin()->first;
+  }
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+void BasicBook<Containers, EventSink, Features>::Match(char aggressor_side) {
+  while (!bids.empty() && !asks.empty()) {
+    auto best_bid_it = bids.begin();
+    auto best_ask_it = asks.begin();
+
+    if (best_bid_it->first < best_ask_it->first) {
+      break;
+    }
+
+    OrderList *bid_list = best_bid_it->second;
+    OrderList *ask_list = best_ask_it->second;
+
+    while (bid_list->head && ask_list->head) {
+      Order *bid_order = bid_list->head;
+      Order *ask_order = ask_list->head;
+
+      Quantity trade_qty = std::min(bid_order->quantity, ask_order->quantity);
+
+      if constexpr (kHashesState) {
+        state_hash.OnQuantityChange(bid_order,
+                                    bid_order->quantity - trade_qty);
+        state_hash.OnQuantityChange(ask_order,
+                                    ask_order->quantity - trade_qty);
+      }
+      if constexpr (kIndexesQueues) {
+        book_utils::ReduceSlot(bid_list, bid_order, trade_qty);
+        book_utils::ReduceSlot(ask_list, ask_order, trade_qty);
+      }
+      if constexpr (kTracksDepth) {
+        bid_depth.Add(bid_order->price, -int64_t{trade_qty});
+        ask_depth.Add(ask_order->price, -int64_t{trade_qty});
+      }
+      bid_order->quantity -= trade_qty;
+      ask_order->quantity -= trade_qty;
+      bid_list->total_quantity -= trade_qty;
+      ask_list->total_quantity -= trade_qty;
+
+      sink.OnFill(FillEvent{bid_order->order_id, ask_order->order_id,
+                            aggressor_side == 'B' ? ask_order->price
+                                                  : bid_order->price,
+                            trade_qty, aggressor_side});
+
+      bool bid_filled = (bid_order->quantity == 0);
+      bool ask_filled = (ask_order->quantity == 0);
+
+      if (bid_filled) {
+        orders.erase(bid_order->order_id);
+        DeleteOrder<databento::Side::Bid>(bid_order);
+      }
+      if (ask_filled) {
+        orders.erase(ask_order->order_id);
+        DeleteOrder<databento::Side::Ask>(ask_order);
+      }
+
+      if (!bid_filled && !ask_filled) {
+        break;
+      }
+    }
+  }
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+void BasicBook<Containers, EventSink, Features>::Publish() {
+  if constexpr (Has(Features, BookFeatures::PublishTop)) {
+    published.Store(book_utils::MakeTopOfBook(bids, asks, position));
+  }
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+void BasicBook<Containers, EventSink, Features>::Snapshot(
+    std::ostream &os) const {
+  unsigned top_count = 0;
+  std::string comma = "";
+
+  for (auto bi = bids.begin(), ai = asks.begin();
+       bi != bids.end() || ai != asks.end(); ++top_count) {
+    os << comma << "    {" << '\n';
+    if (ai != asks.end()) {
+      OrderList *al = ai->second;
+      os << "      \"ask_ct\": " << book_utils::count(al) << "," << '\n';
+      os << "      \"ask_px\": " << ai->first << "," << '\n';
+      os << "      \"ask_sz\": " << book_utils::count_size(al) << "," << '\n';
+      ai = std::next(ai);
+    } else {
+      os << "      \"ask_ct\": " << 0 << "," << '\n';
+      os << "      \"ask_px\": " << 0 << "," << '\n';
+      os << "      \"ask_sz\": " << 0 << "," << '\n';
+    }
+    if (bi != bids.end()) {
+      OrderList *bl = bi->second;
+      os << "      \"bid_ct\": " << book_utils::count(bl) << "," << '\n';
+      os << "      \"bid_px\": " << bi->first << "," << '\n';
+      os << "      \"bid_sz\": " << book_utils::count_size(bl) << '\n';
+      bi = std::next(bi);
+    } else {
+      os << "      \"bid_ct\": " << 0 << "," << '\n';
+      os << "      \"bid_px\": " << 0 << "," << '\n';
+      os << "      \"bid_sz\": " << 0 << '\n';
+    }
+    os << "    }";
+    comma = ",\n";
+  }
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+checkpoint::Writer
+BasicBook<Containers, EventSink, Features>::CreateCheckpoint() const {
+  checkpoint::Writer writer{position};
+  writer.AddLevels('B', bids);
+  writer.AddLevels('A', asks);
+  return writer;
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+void BasicBook<Containers, EventSink, Features>::SaveCheckpoint(
+    const std::string &path) const {
+  CreateCheckpoint().Save(path);
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+void BasicBook<Containers, EventSink, Features>::LoadCheckpoint(
+    const std::string &path) {
+  LoadCheckpoint(checkpoint::Reader{path});
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+void BasicBook<Containers, EventSink, Features>::LoadCheckpoint(
+    const checkpoint::Reader &reader) {
+  Clear();
+  orders.reserve(reader.header().order_count);
+
+  reader.ForEachLevel([this](const checkpoint::Level &level,
+                             const checkpoint::Entry *entries) {
+    OrderList *list = list_pool.acquire();
+    list->head = nullptr;
+    list->tail = nullptr;
+    list->total_quantity = 0;
+    list->order_count = 0;
+    // Levels are stored best first, so each one lands at the end
+    const size_t level_count = bids.size() + asks.size();
+    if (level.side == 'B') {
+      bids.emplace_hint(bids.end(), level.price, list);
+    } else {
+      asks.emplace_hint(asks.end(), level.price, list);
+    }
+    if (bids.size() + asks.size() == level_count) {
+      list_pool.release(list);
+      Clear();
+      throw std::runtime_error("Checkpoint repeats a price level");
+    }
+
+    for (uint32_t i = 0; i < level.order_count; ++i) {
+      Order *order = order_pool.acquire();
+      order->order_id = entries[i].order_id;
+      order->price = level.price;
+      order->quantity = entries[i].quantity;
+      order->side = level.side;
+      order->next = nullptr;
+      order->prev = nullptr;
+      // Index the order before linking it, so a repeated id leaves nothing
+      // behind once the book is cleared
+      if (!orders.emplace(order->order_id, order).second) {
+        order_pool.release(order);
+        Clear();
+        throw std::runtime_error("Checkpoint repeats an order id");
+      }
+      if (level.side == 'B') {
+        AppendOrder<databento::Side::Bid>(list, order);
+      } else {
+        AppendOrder<databento::Side::Ask>(list, order);
+      }
+    }
+  });
+
+  position = reader.header().position;
+  Publish();
+}
+
+template <typename Containers, BookEventSink EventSink, BookFeatures Features>
+void BasicBook<Containers, EventSink, Features>::Clear() {
+  for (auto &[order_id, order] : orders) {
+    order_pool.release(order);
+  }
+  for (auto &[price, list] : bids) {
+    list_pool.release(list);
+  }
+  for (auto &[price, list] : asks) {
+    list_pool.release(list);
+  }
+  orders.clear();
+  bids.clear();
+  asks.clear();
+  position = {};
+  if constexpr (kHashesState) {
+    state_hash.Reset();
+  }
+  if constexpr (kTracksDepth) {
+    bid_depth.Clear();
+    ask_depth.Clear();
+  }
+  Publish();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <concepts>
+
+#include "Order.h"
+
+// Events a book reports to its EventSink while it processes messages. They
+// are passed by reference to stack temporaries, so reporting never
+// allocates.
+
+// One pairing of a bid and an ask while Match() uncrosses the book
+struct FillEvent {
+  OrderId bid_order_id;
+  OrderId ask_order_id;
+  Price price; // Price of the resting order
+  Quantity quantity;
+  char aggressor_side;
+};
+
+// What a book does when an add or modify reaches the opposite touch.
+// CrossLocally matches it against the resting orders and reports the fills,
+// which generated feeds rely on. TrustFeed leaves the book as the feed has
+// it: an exchange MBO feed reports its own fills as 'T'/'F' messages and
+// cancels the filled orders, so matching them again would double-count.
+enum class MatchMode { CrossLocally, TrustFeed };
+
+struct LevelEvent {
+  char side;
+  Price price;
+};
+
+// Best prices after a message, 0 for an empty side
+struct BboEvent {
+  Price bid;
+  Price ask;
+};
+
+// The books take their sink as a template parameter so every call is
+// resolved, and usually inlined, at compile time
+template <typename Sink>
+concept BookEventSink = requires(Sink sink, const FillEvent &fill,
+                                 const LevelEvent &level, const BboEvent &bbo) {
+  sink.OnFill(fill);
+  sink.OnLevelAdded(level);
+  sink.OnLevelRemoved(level);
+  sink.OnBboChanged(bbo);
+};
+
+// Default sink; every call compiles away and it occupies no storage
+struct NullEventSink {
+  void OnFill(const FillEvent &) {}
+  void OnLevelAdded(const LevelEvent &) {}
+  void OnLevelRemoved(const LevelEvent &) {}
+  void OnBboChanged(const BboEvent &) {}
+};
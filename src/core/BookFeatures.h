@@ -0,0 +1,43 @@
+#pragma once
+
+#include <type_traits>
+
+// Optional work a book does on every message, beyond keeping the levels and
+// orders. Each one costs time or memory on the replay path, so a book only
+// pays for the ones its user asks for; a plain book does none of them.
+enum class BookFeatures : unsigned {
+  None = 0,
+  // Store a TopOfBook in Published() after every message
+  PublishTop = 1u << 0,
+  // Keep the Zobrist hash behind StateHash() up to date
+  StateHash = 1u << 1,
+  // Index each level's queue by arrival slot for GetQueuePosition() and
+  // GetQuantityAhead()
+  QueuePositions = 1u << 2,
+  // Keep a DepthLadder per side for QuantityToPrice() and CostToFill()
+  DepthQueries = 1u << 3,
+};
+
+constexpr BookFeatures operator|(BookFeatures a, BookFeatures b) {
+  return static_cast<BookFeatures>(static_cast<unsigned>(a) |
+                                   static_cast<unsigned>(b));
+}
+
+constexpr bool Has(BookFeatures features, BookFeatures feature) {
+  return (static_cast<unsigned>(features) & static_cast<unsigned>(feature)) ==
+         static_cast<unsigned>(feature);
+}
+
+// Takes the place of a switched-off feature's state. Each feature gets its
+// own empty type, so [[no_unique_address]] members of several switched-off
+// features all take no space.
+template <BookFeatures Feature> struct FeatureOff {
+  FeatureOff() = default;
+  // Accepts and ignores whatever the feature's state is constructed from
+  template <typename... Args> explicit FeatureOff(const Args &...) {}
+};
+
+// T when Feature is among Features, otherwise an empty stand-in
+template <BookFeatures Features, BookFeatures Feature, typename T>
+using FeatureState =
+    std::conditional_t<Has(Features, Feature), T, FeatureOff<Feature>>;
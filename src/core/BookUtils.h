@@ -0,0 +1,53 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+#include "Order.h"
+
+// Helpers shared by the book implementations
+namespace book_utils {
+
+inline size_t count(const OrderList *ol) { return ol->order_count; }
+
+inline size_t count_size(const OrderList *ol) { return ol->total_quantity; }
+
+// Gives order the next arrival slot in list's queue index, before it is
+// linked in at the tail. When the slots run out the orders already queued
+// are renumbered from zero into an index twice their number, so appends
+// stay amortized O(log n). A new level starts from a fresh index, since a
+// pooled list may still hold a cleared book's totals.
+inline void EnqueueSlot(OrderList *list, Order *order) {
+  if (list->order_count == 0 || list->next_slot == list->queue.size()) {
+    list->queue.Reset(std::max<size_t>(16, 2 * (list->order_count + 1)));
+    list->next_slot = 0;
+    for (Order *queued = list->head; queued; queued = queued->next) {
+      queued->slot = list->next_slot++;
+      list->queue.Add(queued->slot, {queued->quantity, 1});
+    }
+  }
+  order->slot = list->next_slot++;
+  list->queue.Add(order->slot, {order->quantity, 1});
+}
+
+inline void DequeueSlot(OrderList *list, const Order *order) {
+  list->queue.Add(order->slot, {-int64_t{order->quantity}, -1});
+}
+
+// Before order's quantity is reduced in place by filled
+inline void ReduceSlot(OrderList *list, const Order *order, Quantity filled) {
+  list->queue.Add(order->slot, {-int64_t{filled}, 0});
+}
+
+inline QueueTotals Ahead(const Order *order) {
+  return order->list->queue.PrefixSum(order->slot);
+}
+
+template <typename Book> Price GetBest(const Book &book) {
+  if (book.empty()) {
+    return 0;
+  }
+  return book.begin()->first;
+}
+
+} // namespace book_utils
@@ -0,0 +1,119 @@
+#include "Checkpoint.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace checkpoint {
+
+namespace {
+
+template <typename T> void Append(std::vector<char> &buffer, const T &value) {
+  const char *bytes = reinterpret_cast<const char *>(&value);
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+Header &HeaderOf(std::vector<char> &buffer) {
+  return *reinterpret_cast<Header *>(buffer.data());
+}
+
+} // namespace
+
+Writer::Writer(const ReplayPosition &position) {
+  Header header;
+  header.position = position;
+  Append(buffer_, header);
+}
+
+void Writer::AddLevel(char side, Price price, const OrderList *list) {
+  const size_t level_offset = buffer_.size();
+  Append(buffer_, Level{price, 0, side});
+
+  uint32_t order_count = 0;
+  for (const Order *order = list->head; order != nullptr;
+       order = order->next) {
+    Append(buffer_, Entry{order->order_id, order->quantity});
+    ++order_count;
+  }
+
+  reinterpret_cast<Level *>(buffer_.data() + level_offset)->order_count =
+      order_count;
+
+  Header &header = HeaderOf(buffer_);
+  if (side == 'B') {
+    ++header.bid_levels;
+  } else {
+    ++header.ask_levels;
+  }
+  header.order_count += order_count;
+}
+
+void Writer::Save(const std::string &path) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open checkpoint for writing: " + path);
+  }
+  file.write(buffer_.data(), buffer_.size());
+  if (!file) {
+    throw std::runtime_error("Failed writing checkpoint: " + path);
+  }
+}
+
+Reader::Reader(const std::string &path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open checkpoint: " + path);
+  }
+  storage_.resize(file.tellg());
+  file.seekg(0);
+  file.read(storage_.data(), storage_.size());
+  if (!file) {
+    throw std::runtime_error("Failed reading checkpoint: " + path);
+  }
+  data_ = storage_.data();
+  Validate(storage_.size());
+}
+
+Reader::Reader(const char *data, size_t size) : data_{data} {
+  Validate(size);
+}
+
+void Reader::Validate(size_t size) {
+  if (size < sizeof(Header)) {
+    throw std::runtime_error("Checkpoint truncated");
+  }
+  std::memcpy(&header_, data_, sizeof(Header));
+  if (header_.magic != kMagic) {
+    throw std::runtime_error("Not an order book checkpoint");
+  }
+  if (header_.version != kVersion) {
+    throw std::runtime_error("Unsupported checkpoint version");
+  }
+  // Walk the levels once so that ForEachLevel can trust each order_count
+  const char *cur = data_ + sizeof(Header);
+  const char *end = data_ + size;
+  const uint64_t levels = header_.bid_levels + header_.ask_levels;
+  uint64_t orders = 0;
+  for (uint64_t i = 0; i < levels; ++i) {
+    if (static_cast<size_t>(end - cur) < sizeof(Level)) {
+      throw std::runtime_error("Checkpoint truncated");
+    }
+    Level level;
+    std::memcpy(&level, cur, sizeof(Level));
+    cur += sizeof(Level);
+    if (level.side != 'B' && level.side != 'A') {
+      throw std::runtime_error("Checkpoint level has no side");
+    }
+    if (level.order_count > static_cast<size_t>(end - cur) / sizeof(Entry)) {
+      throw std::runtime_error("Checkpoint truncated");
+    }
+    cur += level.order_count * sizeof(Entry);
+    orders += level.order_count;
+  }
+  if (orders != header_.order_count) {
+    throw std::runtime_error(
+        "Checkpoint order count does not match its levels");
+  }
+}
+
+} // namespace checkpoint
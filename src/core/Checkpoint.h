@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Order.h"
+
+// Position in the MBO stream of the last message applied to a book
+struct ReplayPosition {
+  uint64_t message_count = 0;
+  uint32_t sequence = 0;
+  uint64_t ts_event = 0;
+  uint64_t ts_recv = 0;
+};
+
+// Binary checkpoint of a full book.
+//
+// Layout (native endianness, no padding between records):
+//   Header
+//   for each bid level, best first, then each ask level, best first:
+//     Level
+//     Entry * Level::order_count, in queue priority order
+//
+// The format is independent of the book implementation, so a checkpoint
+// written by one book can be loaded into any other.
+namespace checkpoint {
+
+constexpr uint32_t kMagic = 0x4b43424f; // "OBCK"
+constexpr uint32_t kVersion = 1;
+
+#pragma pack(push, 1)
+struct Header {
+  uint32_t magic = kMagic;
+  uint32_t version = kVersion;
+  ReplayPosition position;
+  uint64_t bid_levels = 0;
+  uint64_t ask_levels = 0;
+  uint64_t order_count = 0;
+};
+
+struct Level {
+  Price price;
+  uint32_t order_count;
+  char side;
+};
+
+struct Entry {
+  OrderId order_id;
+  Quantity quantity;
+};
+#pragma pack(pop)
+
+// Accumulates a checkpoint in memory and writes it with a single write
+class Writer {
+public:
+  explicit Writer(const ReplayPosition &position);
+
+  void AddLevel(char side, Price price, const OrderList *list);
+
+  // The checkpoint bytes so far, e.g. to embed in another file
+  const std::vector<char> &Data() const { return buffer_; }
+  void Save(const std::string &path);
+
+  // Writes every level of a price-ordered container of OrderList pointers
+  template <typename Book> void AddLevels(char side, const Book &book) {
+    for (const auto &[price, list] : book) {
+      AddLevel(side, price, list);
+    }
+  }
+
+private:
+  std::vector<char> buffer_;
+};
+
+// Reads a whole checkpoint into memory in one go and walks it in place
+class Reader {
+public:
+  explicit Reader(const std::string &path);
+  Reader(const char *data, size_t size);
+
+  const Header &header() const { return header_; }
+
+  // Calls fn(const Level &, const Entry *orders) for each level, in file order
+  template <typename Fn> void ForEachLevel(Fn &&fn) const {
+    const char *cur = data_ + sizeof(Header);
+    const uint64_t levels = header_.bid_levels + header_.ask_levels;
+    for (uint64_t i = 0; i < levels; ++i) {
+      const auto *level = reinterpret_cast<const Level *>(cur);
+      cur += sizeof(Level);
+      fn(*level, reinterpret_cast<const Entry *>(cur));
+      cur += level->order_count * sizeof(Entry);
+    }
+  }
+
+private:
+  void Validate(size_t size);
+
+  std::vector<char> storage_;
+  const char *data_ = nullptr;
+  Header header_;
+};
+
+} // namespace checkpoint
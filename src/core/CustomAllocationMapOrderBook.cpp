@@ -0,0 +1,5 @@
+#include "CustomAllocationMapOrderBook.h"
+
+// The plain book is compiled once here; books with other sinks or features
+// are instantiated from the header wherever they are used
+template class BasicBook<PmrMapContainers, NullEventSink>;
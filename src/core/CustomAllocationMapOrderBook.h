@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory_resource>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "Book.h"
+
+// Same containers as OrderBook, but every map and unordered_map node is
+// carved from a single preallocated arena through a pmr pool resource.
+// Released nodes go back to the pool's free lists rather than to malloc, so
+// the only difference from OrderBook is who owns the allocations.
+struct PmrMapContainers {
+  using BidBook = std::pmr::map<Price, OrderList *, std::greater<Price>>;
+  using AskBook = std::pmr::map<Price, OrderList *, std::less<Price>>;
+  using OrderMap = std::pmr::unordered_map<OrderId, Order *>;
+
+  // Matches the books' default pool size, BasicBook::kDefaultPoolSize
+  static constexpr size_t kMaxOrders = 100000;
+  // Room for the bucket array plus one node per order and per price level
+  static constexpr size_t kArenaBytes = 32 * 1024 * 1024;
+  static constexpr size_t kNodesPerChunk = 4096;
+  // Anything larger (i.e. the bucket array) bypasses the pool's free lists
+  static constexpr size_t kLargestNodeBytes = 128;
+
+  struct Arena {
+    Arena()
+        : memory(kArenaBytes),
+          resource(memory.data(), memory.size(),
+                   std::pmr::null_memory_resource()),
+          node_pool({.max_blocks_per_chunk = kNodesPerChunk,
+                     .largest_required_pool_block = kLargestNodeBytes},
+                    &resource) {}
+
+    std::vector<std::byte> memory;
+    std::pmr::monotonic_buffer_resource resource;
+    std::pmr::unsynchronized_pool_resource node_pool;
+  };
+
+  template <typename Container> static Container Make(Arena &arena) {
+    Container container{&arena.node_pool};
+    if constexpr (std::is_same_v<Container, OrderMap>) {
+      // Size the bucket array up front so that no rehash happens mid-replay
+      container.reserve(kMaxOrders);
+    }
+    return container;
+  }
+};
+
+template <BookEventSink EventSink = NullEventSink,
+          BookFeatures Features = BookFeatures::None>
+using BasicCustomAllocationMapOrderBook =
+    BasicBook<PmrMapContainers, EventSink, Features>;
+
+extern template class BasicBook<PmrMapContainers, NullEventSink>;
+
+using CustomAllocationMapOrderBook = BasicCustomAllocationMapOrderBook<>;
@@ -0,0 +1,192 @@
+#include "DatagramFeed.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace feed {
+
+namespace {
+
+constexpr int kReceiveBufferBytes = 8 << 20;
+
+struct Address {
+  sockaddr_storage storage{};
+  socklen_t length = 0;
+  int family = AF_UNSPEC;
+  std::string unix_path;
+};
+
+Address ParseEndpoint(const std::string &endpoint) {
+  Address address;
+  if (endpoint.rfind("unix:", 0) == 0) {
+    auto *un = reinterpret_cast<sockaddr_un *>(&address.storage);
+    address.unix_path = endpoint.substr(5);
+    if (address.unix_path.empty() ||
+        address.unix_path.size() >= sizeof(un->sun_path)) {
+      throw std::runtime_error("Invalid unix socket path: " + endpoint);
+    }
+    un->sun_family = AF_UNIX;
+    std::memcpy(un->sun_path, address.unix_path.c_str(),
+                address.unix_path.size() + 1);
+    address.length = sizeof(sockaddr_un);
+    address.family = AF_UNIX;
+    return address;
+  }
+
+  if (endpoint.rfind("udp:", 0) == 0) {
+    const size_t colon = endpoint.rfind(':');
+    auto *in = reinterpret_cast<sockaddr_in *>(&address.storage);
+    in->sin_family = AF_INET;
+    const std::string host = endpoint.substr(4, colon - 4);
+    if (colon <= 4 ||
+        ::inet_pton(AF_INET, host.c_str(), &in->sin_addr) != 1) {
+      throw std::runtime_error("Invalid udp endpoint: " + endpoint);
+    }
+    in->sin_port = htons(std::stoi(endpoint.substr(colon + 1)));
+    address.length = sizeof(sockaddr_in);
+    address.family = AF_INET;
+    return address;
+  }
+
+  throw std::runtime_error("Endpoint must start with udp: or unix: " +
+                           endpoint);
+}
+
+} // namespace
+
+uint64_t SteadyNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+bool SequenceTracker::Accept(uint64_t sequence, uint16_t record_count) {
+  if (sequence < expected_) {
+    ++stale_packets_;
+    return false;
+  }
+  if (sequence > expected_) {
+    ++gaps_;
+    missing_records_ += sequence - expected_;
+  }
+  expected_ = sequence + record_count;
+  return true;
+}
+
+Sender::Sender(const std::string &endpoint)
+    : buffer_(kMaxDatagramSize / sizeof(uint64_t)) {
+  const Address address = ParseEndpoint(endpoint);
+  fd_ = ::socket(address.family, SOCK_DGRAM, 0);
+  if (fd_ < 0) {
+    throw std::runtime_error("Could not create socket for " + endpoint);
+  }
+  if (::connect(fd_, reinterpret_cast<const sockaddr *>(&address.storage),
+                address.length) != 0) {
+    ::close(fd_);
+    throw std::runtime_error("Could not connect to " + endpoint);
+  }
+}
+
+Sender::~Sender() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+void Sender::Add(const databento::Record &record) {
+  const size_t length = record.Size();
+  if (size_ + length > kMaxDatagramSize) {
+    Flush();
+  }
+  std::memcpy(reinterpret_cast<char *>(buffer_.data()) + size_,
+              &record.Header(), length);
+  size_ += length;
+  ++record_count_;
+}
+
+void Sender::Flush() {
+  if (record_count_ == 0) {
+    return;
+  }
+  Send(size_);
+  next_sequence_ += record_count_;
+  size_ = sizeof(PacketHeader);
+  record_count_ = 0;
+}
+
+void Sender::Finish() {
+  Flush();
+  Send(sizeof(PacketHeader));
+}
+
+void Sender::Send(size_t size) {
+  auto *header = reinterpret_cast<PacketHeader *>(buffer_.data());
+  *header = PacketHeader{next_sequence_, SteadyNanos(), record_count_, {}};
+  // Nobody listening yet is not fatal; the receiver will see a gap
+  if (::send(fd_, buffer_.data(), size, 0) < 0 && errno != ECONNREFUSED) {
+    throw std::runtime_error(std::string("Failed to send datagram: ") +
+                             std::strerror(errno));
+  }
+}
+
+Receiver::Receiver(const std::string &endpoint, size_t batch_size)
+    : batch_size_{batch_size},
+      arena_(batch_size * kMaxDatagramSize / sizeof(uint64_t)),
+      messages_(batch_size), iovecs_(batch_size) {
+  const Address address = ParseEndpoint(endpoint);
+  fd_ = ::socket(address.family, SOCK_DGRAM, 0);
+  if (fd_ < 0) {
+    throw std::runtime_error("Could not create socket for " + endpoint);
+  }
+  ::setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &kReceiveBufferBytes,
+               sizeof(kReceiveBufferBytes));
+
+  if (address.family == AF_UNIX) {
+    ::unlink(address.unix_path.c_str());
+    unix_path_ = address.unix_path;
+  }
+  if (::bind(fd_, reinterpret_cast<const sockaddr *>(&address.storage),
+             address.length) != 0) {
+    ::close(fd_);
+    throw std::runtime_error("Could not bind " + endpoint);
+  }
+
+  for (size_t i = 0; i < batch_size_; ++i) {
+    iovecs_[i].iov_base = const_cast<std::byte *>(Packet(i));
+    iovecs_[i].iov_len = kMaxDatagramSize;
+    messages_[i] = {};
+    messages_[i].msg_hdr.msg_iov = &iovecs_[i];
+    messages_[i].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+Receiver::~Receiver() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+  if (!unix_path_.empty()) {
+    ::unlink(unix_path_.c_str());
+  }
+}
+
+size_t Receiver::ReceiveBatch() {
+  while (true) {
+    const int n = ::recvmmsg(fd_, messages_.data(), batch_size_,
+                             MSG_WAITFORONE, nullptr);
+    if (n >= 0) {
+      return n;
+    }
+    if (errno != EINTR) {
+      throw std::runtime_error(std::string("Failed to receive datagrams: ") +
+                               std::strerror(errno));
+    }
+  }
+}
+
+} // namespace feed
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <vector>
+
+#include "databento/record.hpp"
+
+// Live MBO feed over local UDP or Unix datagram sockets.
+//
+// Each datagram is a PacketHeader followed by record_count whole DBN records,
+// exactly as they are laid out in a DBN file. Packet sequence numbers count
+// records, MoldUDP style, so the receiver can tell how many records a gap
+// lost. A packet with no records marks the end of the stream.
+//
+// Endpoints are written "udp:<ipv4 address>:<port>" or "unix:<path>".
+namespace feed {
+
+constexpr size_t kMaxDatagramSize = 1472; // UDP payload of a 1500 byte MTU
+
+#pragma pack(push, 1)
+struct PacketHeader {
+  uint64_t sequence;     // Sequence of the first record in the packet
+  uint64_t send_ts;      // steady_clock nanoseconds when the packet was sent
+  uint16_t record_count; // 0 marks the end of the stream
+  uint16_t reserved[3];
+};
+#pragma pack(pop)
+
+static_assert(sizeof(PacketHeader) % 8 == 0, "records must stay aligned");
+
+uint64_t SteadyNanos();
+
+// Tracks expected packet sequence numbers and counts what went missing
+class SequenceTracker {
+public:
+  // False for a duplicate or out-of-order packet that should be skipped
+  bool Accept(uint64_t sequence, uint16_t record_count);
+
+  uint64_t gaps() const { return gaps_; }
+  uint64_t missing_records() const { return missing_records_; }
+  uint64_t stale_packets() const { return stale_packets_; }
+
+private:
+  uint64_t expected_ = 1;
+  uint64_t gaps_ = 0;
+  uint64_t missing_records_ = 0;
+  uint64_t stale_packets_ = 0;
+};
+
+// Packs records into datagrams and sends them to an endpoint
+class Sender {
+public:
+  explicit Sender(const std::string &endpoint);
+  ~Sender();
+
+  Sender(const Sender &) = delete;
+  Sender &operator=(const Sender &) = delete;
+
+  // Sends the pending datagram first if the record would not fit
+  void Add(const databento::Record &record);
+  // Sends any pending records as one datagram
+  void Flush();
+  // Flushes and sends the end-of-stream packet
+  void Finish();
+
+private:
+  void Send(size_t size);
+
+  int fd_ = -1;
+  std::vector<uint64_t> buffer_; // uint64_t keeps the records aligned
+  size_t size_ = sizeof(PacketHeader);
+  uint16_t record_count_ = 0;
+  uint64_t next_sequence_ = 1;
+};
+
+// Receives datagrams in batches with recvmmsg into a preallocated arena and
+// hands out records in place, without copying them
+class Receiver {
+public:
+  explicit Receiver(const std::string &endpoint, size_t batch_size = 64);
+  ~Receiver();
+
+  Receiver(const Receiver &) = delete;
+  Receiver &operator=(const Receiver &) = delete;
+
+  // Blocks until at least one datagram arrives, then calls
+  // fn(const databento::Record &, const PacketHeader &) for every record of
+  // every datagram already queued, up to the batch size. Returns false once
+  // the end of the stream has been received.
+  template <typename Fn> bool Poll(Fn &&fn) {
+    const size_t received = ReceiveBatch();
+    for (size_t i = 0; i < received; ++i) {
+      const std::byte *packet = Packet(i);
+      if (messages_[i].msg_len < sizeof(PacketHeader)) {
+        continue;
+      }
+      const auto *header = reinterpret_cast<const PacketHeader *>(packet);
+      if (header->record_count == 0) {
+        finished_ = true;
+        continue;
+      }
+      if (!tracker_.Accept(header->sequence, header->record_count)) {
+        continue;
+      }
+      const std::byte *cur = packet + sizeof(PacketHeader);
+      const std::byte *end = packet + messages_[i].msg_len;
+      for (uint16_t r = 0; r < header->record_count && cur < end; ++r) {
+        if (static_cast<size_t>(end - cur) < sizeof(databento::RecordHeader)) {
+          break;
+        }
+        const databento::Record record{
+            const_cast<databento::RecordHeader *>(
+                reinterpret_cast<const databento::RecordHeader *>(cur))};
+        // A length that is zero or runs past the datagram makes the rest
+        // of it unreadable
+        if (record.Size() == 0 ||
+            record.Size() > static_cast<size_t>(end - cur)) {
+          break;
+        }
+        fn(record, *header);
+        cur += record.Size();
+      }
+    }
+    packets_ += received;
+    return !finished_;
+  }
+
+  const SequenceTracker &Sequence() const { return tracker_; }
+  uint64_t packets() const { return packets_; }
+
+private:
+  size_t ReceiveBatch();
+  const std::byte *Packet(size_t i) const {
+    return reinterpret_cast<const std::byte *>(arena_.data()) +
+           i * kMaxDatagramSize;
+  }
+
+  int fd_ = -1;
+  std::string unix_path_; // Unlinked on destruction
+  size_t batch_size_;
+  std::vector<uint64_t> arena_;
+  std::vector<struct mmsghdr> messages_;
+  std::vector<struct iovec> iovecs_;
+  SequenceTracker tracker_;
+  uint64_t packets_ = 0;
+  bool finished_ = false;
+};
+
+} // namespace feed
@@ -0,0 +1,96 @@
+#include "DbnFileReader.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t kBufferSize = 1 << 20;
+constexpr size_t kPrefixSize = 8; // "DBN", version, u32 metadata length
+constexpr uint8_t kZstdMagic[4] = {0x28, 0xB5, 0x2F, 0xFD};
+
+} // namespace
+
+DbnFileReader::DbnFileReader(const std::string &path) : buffer_(kBufferSize) {
+  fd_ = ::open(path.c_str(), O_RDONLY);
+  if (fd_ < 0) {
+    throw std::runtime_error("Could not open DBN file: " + path);
+  }
+
+  if (!Fill(kPrefixSize)) {
+    throw std::runtime_error("DBN file truncated: " + path);
+  }
+  const auto *prefix = reinterpret_cast<const uint8_t *>(buffer_.data());
+  if (std::memcmp(prefix, kZstdMagic, sizeof(kZstdMagic)) == 0) {
+    throw std::runtime_error(
+        "Compressed DBN files are not seekable, decompress first: " + path);
+  }
+  if (std::memcmp(prefix, "DBN", 3) != 0) {
+    throw std::runtime_error("Not a DBN file: " + path);
+  }
+
+  uint32_t metadata_length;
+  std::memcpy(&metadata_length, prefix + 4, sizeof(metadata_length));
+  data_offset_ = kPrefixSize + metadata_length;
+  Seek(data_offset_);
+}
+
+DbnFileReader::~DbnFileReader() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+void DbnFileReader::Seek(uint64_t offset) {
+  if (::lseek(fd_, offset, SEEK_SET) < 0) {
+    throw std::runtime_error("Failed to seek DBN file");
+  }
+  buffer_offset_ = offset;
+  begin_ = 0;
+  end_ = 0;
+}
+
+bool DbnFileReader::Fill(size_t min_bytes) {
+  if (end_ - begin_ >= min_bytes) {
+    return true;
+  }
+
+  // Shift the partial record to the front and top up the rest of the buffer
+  std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+  buffer_offset_ += begin_;
+  end_ -= begin_;
+  begin_ = 0;
+
+  while (end_ < min_bytes) {
+    const ssize_t n = ::read(fd_, buffer_.data() + end_, buffer_.size() - end_);
+    if (n < 0) {
+      throw std::runtime_error("Failed reading DBN file");
+    }
+    if (n == 0) {
+      return false;
+    }
+    end_ += n;
+  }
+  return true;
+}
+
+const databento::Record *DbnFileReader::NextRecord() {
+  if (!Fill(1)) {
+    return nullptr;
+  }
+  const size_t length = static_cast<uint8_t>(buffer_[begin_]) * 4;
+  if (length == 0) {
+    throw std::runtime_error("Corrupt DBN record");
+  }
+  if (!Fill(length)) {
+    return nullptr;
+  }
+
+  std::memcpy(record_, buffer_.data() + begin_, length);
+  begin_ += length;
+  current_ = databento::Record{
+      reinterpret_cast<databento::RecordHeader *>(record_)};
+  return &current_;
+}
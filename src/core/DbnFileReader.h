@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "databento/record.hpp"
+
+// Minimal reader for uncompressed DBN files that, unlike
+// databento::DbnDecoder, knows the byte offset of every record and can seek
+// straight to one. Records are returned exactly as stored on disk, so no
+// version upgrading is performed; MBO records are identical in all versions.
+class DbnFileReader {
+public:
+  explicit DbnFileReader(const std::string &path);
+  ~DbnFileReader();
+
+  DbnFileReader(const DbnFileReader &) = delete;
+  DbnFileReader &operator=(const DbnFileReader &) = delete;
+
+  // Offset of the first record, just past the metadata
+  uint64_t DataOffset() const { return data_offset_; }
+  // Offset of the record the next call to NextRecord() will return
+  uint64_t Offset() const { return buffer_offset_ + begin_; }
+
+  void Seek(uint64_t offset);
+
+  // Returns nullptr at end of file. The record stays valid until the next
+  // call.
+  const databento::Record *NextRecord();
+
+private:
+  bool Fill(size_t min_bytes);
+
+  int fd_ = -1;
+  uint64_t data_offset_ = 0;
+
+  std::vector<std::byte> buffer_;
+  uint64_t buffer_offset_ = 0; // File offset of buffer_[0]
+  size_t begin_ = 0;
+  size_t end_ = 0;
+
+  // Records are copied here so they are suitably aligned for Get<T>()
+  alignas(8) std::byte record_[255 * 4];
+  databento::Record current_{nullptr};
+};
@@ -0,0 +1,136 @@
+#include "DbnMergeReader.h"
+
+#include "ParallelDbnReader.h"
+
+DbnMergeReader::DbnMergeReader(const std::vector<std::string> &paths,
+                               size_t batch_size, size_t queue_depth)
+    : batch_size_{batch_size}, queue_depth_{queue_depth} {
+  for (const std::string &path : paths) {
+    auto source = std::make_unique<Source>();
+    source->thread = std::thread(&DbnMergeReader::Decode, this,
+                                 std::ref(*source), path);
+    sources_.push_back(std::move(source));
+  }
+
+  try {
+    for (size_t i = 0; i < sources_.size(); ++i) {
+      if (Advance(*sources_[i])) {
+        Push(i);
+      }
+    }
+  } catch (...) {
+    Stop();
+    throw;
+  }
+}
+
+DbnMergeReader::~DbnMergeReader() { Stop(); }
+
+void DbnMergeReader::Stop() {
+  for (auto &source : sources_) {
+    {
+      std::lock_guard<std::mutex> lock(source->mutex);
+      source->stop = true;
+    }
+    source->space_cv.notify_one();
+  }
+  for (auto &source : sources_) {
+    source->thread.join();
+  }
+}
+
+void DbnMergeReader::Decode(Source &source, const std::string &path) {
+  // Hands a batch to the merge, waiting while the queue is full. Returns
+  // false if the reader is being destroyed.
+  auto publish = [&](Batch &batch) {
+    std::unique_lock<std::mutex> lock(source.mutex);
+    source.space_cv.wait(lock, [&] {
+      return source.stop || source.ready.size() < queue_depth_;
+    });
+    if (source.stop) {
+      return false;
+    }
+    source.ready.push_back(std::move(batch));
+    lock.unlock();
+    source.ready_cv.notify_one();
+    return true;
+  };
+
+  try {
+    ParallelDbnReader reader{path};
+
+    Batch batch;
+    batch.reserve(batch_size_);
+    while (const databento::Record *record = reader.NextRecord()) {
+      if (record->RType() != databento::RType::Mbo) {
+        continue;
+      }
+      batch.push_back(record->Get<databento::MboMsg>());
+      if (batch.size() == batch_size_) {
+        if (!publish(batch)) {
+          return;
+        }
+        batch = Batch{};
+        batch.reserve(batch_size_);
+      }
+    }
+    if (!batch.empty() && !publish(batch)) {
+      return;
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(source.mutex);
+    source.error = std::current_exception();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(source.mutex);
+    source.done = true;
+  }
+  source.ready_cv.notify_one();
+}
+
+bool DbnMergeReader::Advance(Source &source) {
+  if (++source.index < source.current.size()) {
+    return true;
+  }
+
+  std::unique_lock<std::mutex> lock(source.mutex);
+  source.ready_cv.wait(lock,
+                       [&] { return !source.ready.empty() || source.done; });
+  if (source.ready.empty()) {
+    if (source.error) {
+      std::rethrow_exception(source.error);
+    }
+    return false;
+  }
+  source.current = std::move(source.ready.front());
+  source.ready.pop_front();
+  source.index = 0;
+  lock.unlock();
+  source.space_cv.notify_one();
+  return true;
+}
+
+void DbnMergeReader::Push(size_t source_index) {
+  const Source &source = *sources_[source_index];
+  const databento::MboMsg &msg = source.current[source.index];
+  heap_.emplace(msg.ts_recv.time_since_epoch().count(), msg.sequence,
+                source_index);
+}
+
+const databento::MboMsg *DbnMergeReader::Next() {
+  if (last_ != SIZE_MAX) {
+    if (Advance(*sources_[last_])) {
+      Push(last_);
+    }
+    last_ = SIZE_MAX;
+  }
+  if (heap_.empty()) {
+    return nullptr;
+  }
+
+  last_ = std::get<2>(heap_.top());
+  heap_.pop();
+  const Source &source = *sources_[last_];
+  return &source.current[source.index];
+}
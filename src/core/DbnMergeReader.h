@@ -0,0 +1,72 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "databento/record.hpp"
+
+// Streams the MBO messages of several DBN files as one stream ordered by
+// (ts_recv, sequence), e.g. a session split across per-venue or per-hour
+// files. Each file is decoded on its own thread into a short queue of
+// batches ahead of the merge, which only compares the heads of the files in
+// a small heap. Records other than MBO are skipped.
+class DbnMergeReader {
+public:
+  explicit DbnMergeReader(const std::vector<std::string> &paths,
+                          size_t batch_size = 4096, size_t queue_depth = 4);
+  ~DbnMergeReader();
+
+  DbnMergeReader(const DbnMergeReader &) = delete;
+  DbnMergeReader &operator=(const DbnMergeReader &) = delete;
+
+  // Returns nullptr once every file is exhausted. The message stays valid
+  // until the next call. Rethrows any error hit by a decoder thread.
+  const databento::MboMsg *Next();
+
+private:
+  using Batch = std::vector<databento::MboMsg>;
+
+  struct Source {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable ready_cv; // Signalled when a batch is queued
+    std::condition_variable space_cv; // Signalled when a batch is taken
+    std::deque<Batch> ready;
+    bool done = false;
+    bool stop = false;
+    std::exception_ptr error;
+
+    // Only touched by the merging thread
+    Batch current;
+    size_t index = 0;
+  };
+
+  // Ties go to the file listed first, so the order is deterministic
+  using HeapEntry = std::tuple<uint64_t, uint32_t, size_t>;
+
+  void Decode(Source &source, const std::string &path);
+  // Wakes and joins the decoder threads
+  void Stop();
+  // Moves source to its next message, fetching a new batch when needed.
+  // Returns false once the file is exhausted.
+  bool Advance(Source &source);
+  void Push(size_t source_index);
+
+  size_t batch_size_;
+  size_t queue_depth_;
+  std::vector<std::unique_ptr<Source>> sources_;
+  std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<>> heap_;
+  // Source of the message returned by the previous call, advanced lazily so
+  // that message stays valid until the next call
+  size_t last_ = SIZE_MAX;
+};
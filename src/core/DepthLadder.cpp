@@ -0,0 +1,220 @@
+#include "DepthLadder.h"
+
+#include <algorithm>
+#include <numeric>
+
+void DepthLadder::Add(Price price, int64_t quantity) {
+  if (quantity == 0) {
+    return;
+  }
+  if (!seen_) {
+    if (levels_.empty()) {
+      levels_.resize(kSlots);
+      window_.Reset(kSlots);
+    }
+    seen_ = true;
+    origin_ = price;
+  }
+
+  const Price outward = Outward(price);
+  if (tick_ == 0 ? outward != 0 : outward % tick_ != 0) {
+    Retick(std::gcd(tick_, outward));
+  }
+  const int64_t price_tick = TickOf(price);
+  if (Empty()) {
+    edge_ = price_tick - kSlack;
+  } else if (price_tick < edge_) {
+    MoveWindow(price_tick - kSlack);
+  }
+
+  // An empty window with levels further out, whether an add landed past
+  // it or a removal emptied it, moves out to the best of them
+  Place(price_tick, quantity);
+  if (window_quantity_ == 0 && !overflow_.empty()) {
+    MoveWindow(overflow_.begin()->first - kSlack);
+  }
+}
+
+void DepthLadder::Clear() {
+  if (!Empty()) {
+    std::fill(levels_.begin(), levels_.end(), Totals{});
+    window_.Assign(levels_);
+  }
+  seen_ = false;
+  tick_ = 0;
+  window_quantity_ = 0;
+  overflow_.clear();
+}
+
+uint64_t DepthLadder::QuantityTo(Price price) const {
+  if (Empty()) {
+    return 0;
+  }
+  const int64_t last = TickOf(price);
+  if (last < edge_) {
+    return 0;
+  }
+  if (InWindow(last)) {
+    return static_cast<uint64_t>(
+        RangeTotals(edge_, last - edge_ + 1).quantity);
+  }
+  int64_t total = window_quantity_;
+  for (auto it = overflow_.begin(); it != overflow_.end() && it->first <= last;
+       ++it) {
+    total += it->second;
+  }
+  return static_cast<uint64_t>(total);
+}
+
+SweepCost DepthLadder::CostToFill(uint64_t quantity) const {
+  SweepCost cost{};
+  if (quantity == 0 || Empty()) {
+    return cost;
+  }
+  const auto wanted = static_cast<int64_t>(quantity);
+  int64_t filled = std::min(wanted, window_quantity_);
+  double notional = 0;
+  if (filled > 0) {
+    Totals before;
+    cost.worst_price = PriceOf(edge_ + Reach(filled, before));
+    notional = Notional(before) +
+               static_cast<double>(filled - before.quantity) * cost.worst_price;
+  }
+  // Past the window, level by level
+  for (auto it = overflow_.begin(); it != overflow_.end() && filled < wanted;
+       ++it) {
+    const int64_t taken = std::min(it->second, wanted - filled);
+    cost.worst_price = PriceOf(it->first);
+    notional += static_cast<double>(taken) * cost.worst_price;
+    filled += taken;
+  }
+  cost.quantity = static_cast<uint64_t>(filled);
+  cost.average_price = notional / static_cast<double>(filled);
+  return cost;
+}
+
+int64_t DepthLadder::TickOf(Price price) const {
+  const Price outward = Outward(price);
+  if (tick_ == 0) {
+    return outward < 0 ? -1 : 0;
+  }
+  return outward >= 0 ? outward / tick_ : -((tick_ - 1 - outward) / tick_);
+}
+
+double DepthLadder::Notional(const Totals &totals) const {
+  const double outward = static_cast<double>(tick_) * totals.weighted;
+  return static_cast<double>(origin_) * totals.quantity +
+         (side_ == 'B' ? -outward : outward);
+}
+
+DepthLadder::Totals DepthLadder::RangeTotals(int64_t first,
+                                             int64_t count) const {
+  const size_t begin = Slot(first);
+  const size_t end = begin + static_cast<size_t>(count);
+  Totals totals;
+  if (end <= kSlots) {
+    totals = window_.PrefixSum(end);
+  } else {
+    // Wraps around the ring
+    totals = window_.PrefixSum(kSlots);
+    totals += window_.PrefixSum(end - kSlots);
+  }
+  totals -= window_.PrefixSum(begin);
+  return totals;
+}
+
+int64_t DepthLadder::Reach(int64_t quantity, Totals &before) const {
+  const size_t begin = Slot(edge_);
+  const Totals head = window_.PrefixSum(begin);
+  Totals tail = window_.PrefixSum(kSlots);
+  tail -= head;
+
+  size_t slot;
+  if (tail.quantity >= quantity) {
+    slot = window_.Search([&](const Totals &t) {
+      return t.quantity - head.quantity >= quantity;
+    });
+    before = window_.PrefixSum(slot);
+    before -= head;
+  } else {
+    // The rest is in the slots the window wrapped around into
+    const int64_t rest = quantity - tail.quantity;
+    slot = window_.Search(
+        [rest](const Totals &t) { return t.quantity >= rest; });
+    before = tail;
+    before += window_.PrefixSum(slot);
+  }
+  return static_cast<int64_t>((slot - begin) & (kSlots - 1));
+}
+
+void DepthLadder::Place(int64_t tick, int64_t quantity) {
+  if (InWindow(tick)) {
+    const Totals delta{quantity, quantity * tick};
+    levels_[Slot(tick)] += delta;
+    window_.Add(Slot(tick), delta);
+    window_quantity_ += quantity;
+    return;
+  }
+  auto it = overflow_.emplace(tick, 0).first;
+  it->second += quantity;
+  if (it->second == 0) {
+    overflow_.erase(it);
+  }
+}
+
+void DepthLadder::MoveWindow(int64_t edge) {
+  // Ticks of the old window that the new one no longer covers
+  const int64_t first =
+      edge < edge_ ? std::max(edge + kWindow, edge_) : edge_;
+  const int64_t last =
+      edge < edge_ ? edge_ + kWindow : std::min(edge, edge_ + kWindow);
+  if (first < last && RangeTotals(first, last - first).quantity != 0) {
+    for (int64_t tick = first; tick < last; ++tick) {
+      Totals &level = levels_[Slot(tick)];
+      if (level.quantity != 0) {
+        overflow_.emplace(tick, 0).first->second += level.quantity;
+        window_quantity_ -= level.quantity;
+        Totals removed;
+        removed -= level;
+        window_.Add(Slot(tick), removed);
+        level = Totals{};
+      }
+    }
+  }
+
+  // Levels the new window covers, placed and then erased in one go
+  edge_ = edge;
+  const auto first_in = overflow_.lower_bound(edge_);
+  auto last_in = first_in;
+  for (; last_in != overflow_.end() && InWindow(last_in->first); ++last_in) {
+    Place(last_in->first, last_in->second);
+  }
+  overflow_.erase(first_in, last_in);
+}
+
+void DepthLadder::Retick(Price tick) {
+  retick_scratch_.clear();
+  if (window_quantity_ != 0) {
+    for (int64_t offset = 0; offset < kWindow; ++offset) {
+      const Totals &level = levels_[Slot(edge_ + offset)];
+      if (level.quantity != 0) {
+        retick_scratch_.emplace_back(PriceOf(edge_ + offset), level.quantity);
+      }
+    }
+    std::fill(levels_.begin(), levels_.end(), Totals{});
+    window_.Assign(levels_);
+    window_quantity_ = 0;
+  }
+  for (const auto &[level_tick, quantity] : overflow_) {
+    retick_scratch_.emplace_back(PriceOf(level_tick), quantity);
+  }
+  overflow_.clear();
+
+  // The old tick is a multiple of the new one, so the edge stays in place.
+  // Without one, every level so far was at the origin.
+  edge_ = tick_ == 0 ? -kSlack : edge_ * (tick_ / tick);
+  tick_ = tick;
+  for (const auto &[price, quantity] : retick_scratch_) {
+    Place(TickOf(price), quantity);
+  }
+}
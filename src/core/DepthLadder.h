@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "FenwickTree.h"
+#include "FlatMap.h"
+#include "Order.h"
+
+// What sweeping a quantity from one side of a book would cost
+struct SweepCost {
+  uint64_t quantity;    // Filled, less than asked if the side runs out
+  Price worst_price;    // Last level reached, 0 if nothing filled
+  double average_price; // Volume-weighted, 0 if nothing filled
+};
+
+// Resting quantity of one side of a book, kept as prefix sums by tick so
+// that cumulative depth and sweep costs near the touch take O(log n)
+// instead of a walk over every level.
+//
+// Prices are numbered in ticks outward from the first price seen, and the
+// tick is the gcd of the distances seen so far, so it needs no
+// configuring. A window of kSlots ticks starting at or just beyond the
+// best level lives in a ring of slots, so moving it only touches the
+// levels that enter or leave it. Levels further out go to an overflow
+// sorted by tick, reserved up front so the replay path does not allocate,
+// which queries walk only once they have used up the whole window. The
+// window moves when a level arrives better than its edge, or when it
+// empties while levels remain further out.
+class DepthLadder {
+public:
+  static constexpr size_t kSlots = 4096;
+
+  // Overflow levels held before the overflow has to grow
+  static constexpr size_t kOverflowLevels = 256;
+
+  // side is 'B' or 'A', and decides which direction is better
+  explicit DepthLadder(char side) : side_{side}, overflow_{kOverflowLevels} {}
+
+  // Adds quantity resting at price, or removes it if negative
+  void Add(Price price, int64_t quantity);
+
+  void Clear();
+
+  // Quantity resting at price or better
+  uint64_t QuantityTo(Price price) const;
+
+  // Cost of taking quantity from the best level outward
+  SweepCost CostToFill(uint64_t quantity) const;
+
+private:
+  // Per tick, and summed by the tree: the quantity, and the quantity times
+  // the tick number for the notional
+  struct Totals {
+    int64_t quantity = 0;
+    int64_t weighted = 0;
+    Totals &operator+=(const Totals &other) {
+      quantity += other.quantity;
+      weighted += other.weighted;
+      return *this;
+    }
+    Totals &operator-=(const Totals &other) {
+      quantity -= other.quantity;
+      weighted -= other.weighted;
+      return *this;
+    }
+  };
+
+  static constexpr int64_t kWindow = kSlots;
+  // Ticks left between the edge and a new best level when the window moves
+  static constexpr int64_t kSlack = kSlots / 8;
+
+  bool Empty() const { return window_quantity_ == 0 && overflow_.empty(); }
+
+  Price Outward(Price price) const {
+    return side_ == 'B' ? origin_ - price : price - origin_;
+  }
+  // Tick number of price, rounded toward the better side, or -1 for any
+  // price better than the only one seen so far
+  int64_t TickOf(Price price) const;
+  Price PriceOf(int64_t tick) const {
+    return side_ == 'B' ? origin_ - tick * tick_ : origin_ + tick * tick_;
+  }
+  size_t Slot(int64_t tick) const {
+    return static_cast<size_t>(tick) & (kSlots - 1);
+  }
+  bool InWindow(int64_t tick) const {
+    return tick >= edge_ && tick < edge_ + kWindow;
+  }
+  double Notional(const Totals &totals) const;
+
+  // Sum over count ticks of the window from first, with count <= kSlots
+  Totals RangeTotals(int64_t first, int64_t count) const;
+  // Offset from the edge of the tick at which the window's running total
+  // reaches quantity, which must not exceed window_quantity_, and the
+  // totals before it
+  int64_t Reach(int64_t quantity, Totals &before) const;
+
+  void Place(int64_t tick, int64_t quantity);
+  void MoveWindow(int64_t edge);
+  // Renumbers every level for a finer tick
+  void Retick(Price tick);
+
+  char side_;
+  bool seen_ = false;
+  Price origin_ = 0; // First price seen, tick 0
+  Price tick_ = 0;   // 0 until a second distinct price arrives
+  int64_t edge_ = 0; // First tick of the window
+  int64_t window_quantity_ = 0;
+  std::vector<Totals> levels_;
+  FenwickTree<Totals> window_;
+  FlatMap<int64_t, int64_t, std::less<int64_t>> overflow_; // By tick
+  std::vector<std::pair<Price, int64_t>> retick_scratch_;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <vector>
+
+// Binary indexed tree over a fixed number of slots: point updates and
+// prefix sums in O(log n). T needs a zero value from T{} and operator+=.
+template <typename T> class FenwickTree {
+public:
+  size_t size() const { return tree_.size(); }
+
+  // Resizes to size slots, all zero, reusing the storage
+  void Reset(size_t size) { tree_.assign(size, T{}); }
+
+  // Replaces the contents with values, one per slot, in O(n)
+  void Assign(const std::vector<T> &values) {
+    tree_ = values;
+    for (size_t slot = 0; slot < tree_.size(); ++slot) {
+      const size_t parent = slot | (slot + 1);
+      if (parent < tree_.size()) {
+        tree_[parent] += tree_[slot];
+      }
+    }
+  }
+
+  void Add(size_t slot, const T &delta) {
+    for (; slot < tree_.size(); slot |= slot + 1) {
+      tree_[slot] += delta;
+    }
+  }
+
+  // Sum of slots [0, end)
+  T PrefixSum(size_t end) const {
+    T sum{};
+    for (; end > 0; end &= end - 1) {
+      sum += tree_[end - 1];
+    }
+    return sum;
+  }
+
+  // First slot whose prefix sum, up to and including it, satisfies
+  // reached, or size() if none does. reached must stay true once it is,
+  // as it does for a running total of non-negative values.
+  template <typename Predicate> size_t Search(Predicate reached) const {
+    size_t end = 0;
+    T sum{};
+    for (size_t step = std::bit_floor(tree_.size()); step > 0; step >>= 1) {
+      if (end + step <= tree_.size()) {
+        T next = sum;
+        next += tree_[end + step - 1];
+        if (!reached(next)) {
+          end += step;
+          sum = next;
+        }
+      }
+    }
+    return end;
+  }
+
+private:
+  std::vector<T> tree_;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm> // For std::lower_bound
+#include <iterator>
+#include <utility>
+#include <vector>
+
+// Custom FlatMap implementation using a sorted std::vector
+template <typename Key, typename Value, typename Compare> class FlatMap {
+public:
+  using value_type = std::pair<Key, Value>;
+  using container_type = std::vector<value_type>;
+  using iterator = typename container_type::iterator;
+  using const_iterator = typename container_type::const_iterator;
+
+  FlatMap(size_t reserve_size = 1000) { data_.reserve(reserve_size); }
+
+  iterator lower_bound(const Key &key) {
+    return std::lower_bound(data_.begin(), data_.end(), key,
+                            [](const value_type &element, const Key &k) {
+                              return Compare()(element.first, k);
+                            });
+  }
+
+  iterator find(const Key &key) {
+    auto it = std::lower_bound(data_.begin(), data_.end(), key,
+                               [](const value_type &element, const Key &k) {
+                                 return Compare()(element.first, k);
+                               });
+    if (it != data_.end() && !Compare()(key, it->first)) {
+      return it;
+    }
+    return data_.end();
+  }
+
+  const_iterator find(const Key &key) const {
+    auto it = std::lower_bound(data_.begin(), data_.end(), key,
+                               [](const value_type &element, const Key &k) {
+                                 return Compare()(element.first, k);
+                               });
+    if (it != data_.end() && !Compare()(key, it->first)) {
+      return it;
+    }
+    return data_.end();
+  }
+
+  std::pair<iterator, bool> emplace(const Key &key, Value value) {
+    auto it = std::lower_bound(data_.begin(), data_.end(), key,
+                               [](const value_type &element, const Key &k) {
+                                 return Compare()(element.first, k);
+                               });
+    if (it != data_.end() && !Compare()(key, it->first)) {
+      return {it, false}; // Key already exists
+    }
+    return {data_.insert(it, {key, value}), true};
+  }
+
+  // Appends in O(1) when the hint is end() and key sorts last, as it does
+  // when levels are loaded best first
+  iterator emplace_hint(const_iterator hint, const Key &key, Value value) {
+    if (hint == data_.end() &&
+        (data_.empty() || Compare()(data_.back().first, key))) {
+      data_.emplace_back(key, value);
+      return std::prev(data_.end());
+    }
+    return emplace(key, value).first;
+  }
+
+  size_t erase(const Key &key) {
+    auto it = find(key);
+    if (it == data_.end()) {
+      return 0;
+    }
+    data_.erase(it);
+    return 1;
+  }
+  void erase(iterator it) { data_.erase(it); }
+  void erase(iterator first, iterator last) { data_.erase(first, last); }
+
+  void clear() { data_.clear(); }
+
+  bool empty() const { return data_.empty(); }
+
+  size_t size() const { return data_.size(); }
+
+  iterator begin() { return data_.begin(); }
+  const_iterator begin() const { return data_.begin(); }
+  iterator end() { return data_.end(); }
+  const_iterator end() const { return data_.end(); }
+
+  value_type &front() { return data_.front(); }
+  const value_type &front() const { return data_.front(); }
+
+private:
+  container_type data_;
+};
@@ -0,0 +1,284 @@
+#include "Heatmap.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace heatmap {
+
+namespace {
+
+uint32_t Crc32(const uint8_t *data, size_t size, uint32_t crc = 0) {
+  static const std::array<uint32_t, 256> table = [] {
+    std::array<uint32_t, 256> entries{};
+    for (uint32_t n = 0; n < entries.size(); ++n) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; ++k) {
+        c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+      }
+      entries[n] = c;
+    }
+    return entries;
+  }();
+  crc = ~crc;
+  for (size_t i = 0; i < size; ++i) {
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+uint32_t Adler32(const std::vector<uint8_t> &data) {
+  uint32_t a = 1;
+  uint32_t b = 0;
+  for (const uint8_t byte : data) {
+    a = (a + byte) % 65521;
+    b = (b + a) % 65521;
+  }
+  return (b << 16) | a;
+}
+
+void AppendBigEndian(std::vector<uint8_t> &out, uint32_t value) {
+  out.push_back(static_cast<uint8_t>(value >> 24));
+  out.push_back(static_cast<uint8_t>(value >> 16));
+  out.push_back(static_cast<uint8_t>(value >> 8));
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+void AppendChunk(std::vector<uint8_t> &png, const char (&type)[5],
+                 const std::vector<uint8_t> &data) {
+  AppendBigEndian(png, static_cast<uint32_t>(data.size()));
+  const size_t start = png.size();
+  png.insert(png.end(), type, type + 4);
+  png.insert(png.end(), data.begin(), data.end());
+  AppendBigEndian(png, Crc32(png.data() + start, png.size() - start));
+}
+
+// A zlib stream of stored (uncompressed) deflate blocks, which every PNG
+// reader accepts without this needing a compressor
+std::vector<uint8_t> StoredZlib(const std::vector<uint8_t> &data) {
+  constexpr size_t kMaxBlock = 65535;
+  std::vector<uint8_t> out{0x78, 0x01};
+  out.reserve(data.size() + data.size() / kMaxBlock * 5 + 16);
+  size_t offset = 0;
+  do {
+    const size_t size = std::min(kMaxBlock, data.size() - offset);
+    const bool last = offset + size == data.size();
+    out.push_back(last ? 1 : 0);
+    out.push_back(static_cast<uint8_t>(size));
+    out.push_back(static_cast<uint8_t>(size >> 8));
+    out.push_back(static_cast<uint8_t>(~size));
+    out.push_back(static_cast<uint8_t>(~size >> 8));
+    out.insert(out.end(), data.begin() + offset, data.begin() + offset + size);
+    offset += size;
+  } while (offset < data.size());
+  AppendBigEndian(out, Adler32(data));
+  return out;
+}
+
+} // namespace
+
+Recorder::Recorder(uint32_t instrument_id, const Config &config,
+                   std::string path)
+    : path_{std::move(path)} {
+  if (config.bin_nanos == 0 || config.rows == 0) {
+    throw std::invalid_argument("Heatmap bins must not be empty");
+  }
+  if (config.price_step < 0) {
+    throw std::invalid_argument("Heatmap price step must not be negative");
+  }
+  header_.rows = config.rows;
+  header_.instrument_id = instrument_id;
+  header_.bin_nanos = config.bin_nanos;
+  header_.price_step = config.price_step;
+  cells_.resize(header_.rows);
+  batch_.reserve(kBatchBytes);
+  std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(&header_), sizeof(header_));
+  if (!out) {
+    throw std::runtime_error("Could not open heatmap file for writing: " +
+                             path_);
+  }
+}
+
+void Recorder::Repeat() {
+  column_.ts = bin_ * header_.bin_nanos;
+  Append();
+}
+
+void Recorder::Append() {
+  const char *column = reinterpret_cast<const char *>(&column_);
+  const char *cells = reinterpret_cast<const char *>(cells_.data());
+  batch_.insert(batch_.end(), column, column + sizeof(column_));
+  batch_.insert(batch_.end(), cells, cells + cells_.size() * sizeof(float));
+  ++column_count_;
+  if (batch_.size() >= kBatchBytes) {
+    Flush();
+  }
+}
+
+void Recorder::Flush() {
+  std::fstream out(path_, std::ios::binary | std::ios::in | std::ios::out);
+  out.seekp(0, std::ios::end);
+  out.write(batch_.data(), batch_.size());
+  // The step may have been learned since the header was last written
+  out.seekp(0);
+  out.write(reinterpret_cast<const char *>(&header_), sizeof(header_));
+  out.flush();
+  if (!out) {
+    throw std::runtime_error("Failed writing heatmap file: " + path_);
+  }
+  batch_.clear();
+}
+
+void Recorder::LearnStep(Price price) {
+  if (!has_price_) {
+    has_price_ = true;
+    first_price_ = price;
+  }
+  learned_step_ = std::gcd(learned_step_, price - first_price_);
+}
+
+int64_t Recorder::FloorDiv(Price price, Price step) {
+  const int64_t quotient = price / step;
+  return quotient * step > price ? quotient - 1 : quotient;
+}
+
+Reader::Reader(const std::string &path)
+    : path_{path}, in_{path, std::ios::binary} {
+  if (!in_) {
+    throw std::runtime_error("Could not open heatmap file: " + path);
+  }
+  in_.read(reinterpret_cast<char *>(&header_), sizeof(header_));
+  if (!in_ || header_.magic != kMagic) {
+    throw std::runtime_error("Not a heatmap file: " + path);
+  }
+  if (header_.version != kVersion) {
+    throw std::runtime_error("Unsupported heatmap file version: " + path);
+  }
+}
+
+bool Reader::Next(Column &column, std::vector<float> &cells) {
+  if (!in_.read(reinterpret_cast<char *>(&column), sizeof(column))) {
+    return false;
+  }
+  cells.resize(header_.rows);
+  if (!in_.read(reinterpret_cast<char *>(cells.data()),
+                header_.rows * sizeof(float))) {
+    throw std::runtime_error("Heatmap file truncated: " + path_);
+  }
+  return true;
+}
+
+void Reader::Rewind() {
+  in_.clear();
+  in_.seekg(sizeof(Header));
+}
+
+Matrix Read(const std::string &path) {
+  Reader reader{path};
+  Matrix matrix;
+  matrix.header = reader.header();
+  Column column;
+  std::vector<float> cells;
+  while (reader.Next(column, cells)) {
+    matrix.columns.push_back(column);
+    matrix.cells.insert(matrix.cells.end(), cells.begin(), cells.end());
+  }
+  return matrix;
+}
+
+void WritePng(const std::string &path, Reader &reader,
+              const RenderConfig &config) {
+  if (config.max_width == 0 || config.max_height == 0) {
+    throw std::invalid_argument("Heatmap image must not be empty");
+  }
+  // Rows of the whole matrix, across every column's window
+  const Header &header = reader.header();
+  const int64_t rows = header.rows;
+  int64_t low = 0;
+  int64_t high = rows;
+  bool any = false;
+  size_t column_count = 0;
+  Column column;
+  std::vector<float> cells;
+  reader.Rewind();
+  while (reader.Next(column, cells)) {
+    ++column_count;
+    if (column.first_row != kNoRows) {
+      low = any ? std::min(low, column.first_row) : column.first_row;
+      high = any ? std::max(high, column.first_row + rows)
+                 : column.first_row + rows;
+      any = true;
+    }
+  }
+
+  const size_t columns = std::max<size_t>(column_count, 1);
+  const size_t span = high - low;
+  const size_t x_scale = (columns + config.max_width - 1) / config.max_width;
+  const size_t y_scale = (span + config.max_height - 1) / config.max_height;
+  const size_t width = (columns + x_scale - 1) / x_scale;
+  const size_t height = (span + y_scale - 1) / y_scale;
+
+  // Quantity per pixel, bids and asks apart
+  std::vector<double> bids(width * height);
+  std::vector<double> asks(width * height);
+  reader.Rewind();
+  for (size_t i = 0; reader.Next(column, cells); ++i) {
+    if (column.first_row == kNoRows) {
+      continue;
+    }
+    // With one side empty, the whole column belongs to the other
+    constexpr double kInfinity = std::numeric_limits<double>::infinity();
+    const double mid =
+        column.best_ask == 0   ? kInfinity
+        : column.best_bid == 0 ? -kInfinity
+                               : column.best_bid / 2.0 + column.best_ask / 2.0;
+    for (int64_t r = 0; r < rows; ++r) {
+      const int64_t row = column.first_row + r;
+      const size_t y = static_cast<size_t>(high - 1 - row) / y_scale;
+      const size_t pixel = y * width + i / x_scale;
+      const double price = static_cast<double>(row) * header.price_step;
+      (price < mid ? bids : asks)[pixel] += cells[r];
+    }
+  }
+  double max_quantity = 0;
+  for (size_t pixel = 0; pixel < bids.size(); ++pixel) {
+    max_quantity = std::max({max_quantity, bids[pixel], asks[pixel]});
+  }
+  const double scale = max_quantity > 0 ? 255 / std::log1p(max_quantity) : 0;
+
+  // Scanlines with filter type 0, highest price first
+  std::vector<uint8_t> image;
+  image.reserve(height * (1 + width * 3));
+  for (size_t y = 0; y < height; ++y) {
+    image.push_back(0);
+    for (size_t x = 0; x < width; ++x) {
+      const size_t pixel = y * width + x;
+      image.push_back(static_cast<uint8_t>(std::log1p(asks[pixel]) * scale));
+      image.push_back(static_cast<uint8_t>(std::log1p(bids[pixel]) * scale));
+      image.push_back(0);
+    }
+  }
+
+  std::vector<uint8_t> png{0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  std::vector<uint8_t> ihdr;
+  AppendBigEndian(ihdr, static_cast<uint32_t>(width));
+  AppendBigEndian(ihdr, static_cast<uint32_t>(height));
+  ihdr.insert(ihdr.end(), {8, 2, 0, 0, 0}); // 8-bit RGB, not interlaced
+  AppendChunk(png, "IHDR", ihdr);
+  AppendChunk(png, "IDAT", StoredZlib(image));
+  AppendChunk(png, "IEND", {});
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(png.data()), png.size());
+  out.flush();
+  if (!out) {
+    throw std::runtime_error("Failed writing heatmap image: " + path);
+  }
+}
+
+} // namespace heatmap
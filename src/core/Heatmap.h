@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "databento/record.hpp"
+
+#include "Order.h"
+
+// Binned price x time depth matrix, sampled from a book while it is
+// replayed and written out column by column, so a heatmap never needs the
+// messages or the matrix held in memory.
+//
+// Each column is the resting quantity in `rows` price bins of `price_step`
+// centred on the mid at the end of a time bin. File layout (native
+// endianness): Header, then per column a Column followed by `rows` floats,
+// lowest price first.
+namespace heatmap {
+
+constexpr uint32_t kMagic = 0x54414548; // "HEAT"
+constexpr uint32_t kVersion = 1;
+
+// first_row of a column captured before the book had a price
+constexpr int64_t kNoRows = std::numeric_limits<int64_t>::min();
+
+struct Config {
+  uint64_t bin_nanos = 1000000000; // Width of a column
+  uint32_t rows = 256;             // Price bins per column
+  Price price_step = 0;            // Width of a price bin; 0 for one tick
+};
+
+struct Header {
+  uint32_t magic = kMagic;
+  uint32_t version = kVersion;
+  uint32_t rows = 0;
+  uint32_t instrument_id = 0;
+  uint64_t bin_nanos = 0;
+  Price price_step = 0;
+};
+
+// Row r of a column holds the prices from (first_row + r) * price_step up
+// to the next row
+struct Column {
+  uint64_t ts;    // Start of the time bin
+  Price best_bid; // 0 for an empty side
+  Price best_ask;
+  int64_t first_row;
+};
+
+// A whole heatmap file, read at once
+struct Matrix {
+  Header header;
+  std::vector<Column> columns;
+  std::vector<float> cells; // rows per column, column after column
+
+  const float *Cells(size_t column) const {
+    return cells.data() + column * header.rows;
+  }
+};
+
+// Samples one instrument's book into a heatmap file. Call Update() before
+// the book applies each message, so that a column shows the book as it
+// stood at the end of its bin; bins without messages repeat the column
+// before them. With price_step 0 the step is the gcd of the price
+// differences added until the first column, and columns before two prices
+// have been seen are empty. The book must keep depth ladders
+// (BookFeatures::DepthQueries).
+//
+// Only the latest column is kept in memory. Columns are appended to the
+// file in batches of about kBatchBytes, opening it for each batch so that
+// a file with many instruments does not hold a descriptor for each, and
+// the header is rewritten with the step learned so far. Finish() writes
+// the rest.
+class Recorder {
+public:
+  static constexpr size_t kBatchBytes = 64 * 1024;
+
+  // Creates (or truncates) the file at path and writes the header
+  Recorder(uint32_t instrument_id, const Config &config, std::string path);
+
+  template <typename Book>
+  void Update(const databento::MboMsg &msg, const Book &book) {
+    const uint64_t ts = msg.ts_recv.time_since_epoch().count();
+    if (!started_) {
+      started_ = true;
+      bin_ = ts / header_.bin_nanos;
+    }
+    if (ts / header_.bin_nanos > bin_) {
+      Capture(book);
+      const uint64_t bin = ts / header_.bin_nanos;
+      while (++bin_ < bin) {
+        Repeat();
+      }
+    }
+    if (header_.price_step == 0 && msg.action == 'A') {
+      LearnStep(msg.price);
+    }
+  }
+
+  // Captures the bin of the last message and writes everything not yet
+  // written
+  template <typename Book> void Finish(const Book &book) {
+    if (started_) {
+      Capture(book);
+      started_ = false;
+    }
+    Flush();
+  }
+
+  const Header &header() const { return header_; }
+  size_t ColumnCount() const { return column_count_; }
+
+private:
+  template <typename Book> void Capture(const Book &book) {
+    const Price best_bid = book.GetBestBid();
+    const Price best_ask = book.GetBestAsk();
+    column_ = Column{bin_ * header_.bin_nanos, best_bid, best_ask, kNoRows};
+    std::fill(cells_.begin(), cells_.end(), 0.0f);
+    if (header_.price_step == 0) {
+      // Freeze the learned step so that every column shares one axis
+      header_.price_step = learned_step_;
+    }
+    const Price step = header_.price_step;
+    if (step != 0 && (best_bid != 0 || best_ask != 0)) {
+      const Price mid = best_bid == 0   ? best_ask
+                        : best_ask == 0 ? best_bid
+                                        : std::midpoint(best_bid, best_ask);
+      column_.first_row = FloorDiv(mid, step) - header_.rows / 2;
+      // Quantity at or better than the start of each bin, so a bin holds
+      // the difference between its edges: bids at or above the lower
+      // edge, asks below the upper one
+      Price low = column_.first_row * step;
+      uint64_t bids = book.QuantityToPrice('B', low);
+      uint64_t asks = book.QuantityToPrice('A', low - 1);
+      for (uint32_t row = 0; row < header_.rows; ++row) {
+        const Price high = low + step;
+        const uint64_t bids_above = book.QuantityToPrice('B', high);
+        const uint64_t asks_below = book.QuantityToPrice('A', high - 1);
+        cells_[row] =
+            static_cast<float>(bids - bids_above + asks_below - asks);
+        bids = bids_above;
+        asks = asks_below;
+        low = high;
+      }
+    }
+    Append();
+  }
+
+  void Repeat();
+  void Append();
+  void Flush();
+  void LearnStep(Price price);
+  static int64_t FloorDiv(Price price, Price step);
+
+  Header header_;
+  std::string path_;
+  Column column_{}; // The latest column, with cells_
+  std::vector<float> cells_;
+  std::vector<char> batch_; // Bytes not yet written to path_
+  size_t column_count_ = 0;
+  bool started_ = false;
+  uint64_t bin_ = 0; // Index of the bin in progress
+  bool has_price_ = false;
+  Price first_price_ = 0;
+  Price learned_step_ = 0;
+};
+
+// Reads a heatmap file one column at a time
+class Reader {
+public:
+  explicit Reader(const std::string &path);
+
+  const Header &header() const { return header_; }
+
+  // Reads the next column and its rows cells; false after the last one
+  bool Next(Column &column, std::vector<float> &cells);
+
+  // Goes back to the first column
+  void Rewind();
+
+private:
+  std::string path_;
+  std::ifstream in_;
+  Header header_;
+};
+
+// Scales a heatmap down to fit the image and colours each pixel by the log
+// of its quantity: green below the mid, red above it
+struct RenderConfig {
+  uint32_t max_width = 1600;
+  uint32_t max_height = 800;
+};
+
+Matrix Read(const std::string &path);
+// Reads the file twice: once for the price range, once for the pixels
+void WritePng(const std::string &path, Reader &reader,
+              const RenderConfig &config);
+
+} // namespace heatmap
@@ -0,0 +1,260 @@
+#include "MarketGenerator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace {
+
+constexpr int64_t kInitialMidPrice = 100000000000; // $100.00
+constexpr int64_t kPriceTick = 1000000;            // $0.01
+
+constexpr uint64_t kFeedLatencyNanos = 20000; // ts_event to ts_recv
+
+constexpr int64_t kFlashCrashDropPerMessage = 5 * kPriceTick;
+constexpr int64_t kQuoteStuffingOffset = 50 * kPriceTick; // Far from mid
+constexpr int64_t kPriceJump = 100 * kPriceTick;
+
+bool InWindow(uint64_t index, uint64_t start, uint64_t length) {
+  return index >= start && index < start + length;
+}
+
+} // namespace
+
+MarketCondition ParseMarketCondition(const std::string &name) {
+  if (name == "HighVolatility")
+    return MarketCondition::HighVolatility;
+  if (name == "FlashCrash")
+    return MarketCondition::FlashCrash;
+  if (name == "BookChurn")
+    return MarketCondition::BookChurn;
+  if (name == "QuoteStuffing")
+    return MarketCondition::QuoteStuffing;
+  if (name == "LargeOrderImbalance")
+    return MarketCondition::LargeOrderImbalance;
+  if (name == "LiquidityDrain")
+    return MarketCondition::LiquidityDrain;
+  if (name == "PriceJump")
+    return MarketCondition::PriceJump;
+  throw std::invalid_argument("Invalid market condition: " + name);
+}
+
+MarketGenerator::MarketGenerator(const Config &config)
+    : condition_{config.condition}, messages_{config.messages},
+      first_message_{config.first_message},
+      scenario_messages_{config.scenario_messages > 0
+                             ? config.scenario_messages
+                             : config.messages},
+      depth_{config.depth},
+      max_live_orders_{std::max<size_t>(config.max_live_orders, 1)},
+      initial_messages_{uint64_t{config.instruments} * config.depth * 2},
+      rng_{config.seed}, next_order_id_{config.first_order_id},
+      ts_{config.start_ts} {
+  if (config.instruments == 0) {
+    throw std::invalid_argument("MarketGenerator needs an instrument");
+  }
+  instruments_.reserve(config.instruments);
+  for (uint32_t i = 0; i < config.instruments; ++i) {
+    // Stream 0 is rng_, so each instrument draws from stream i + 1
+    instruments_.push_back({i + 1, kInitialMidPrice, config.first_sequence - 1,
+                            Rng{config.seed, i + 1}, {}});
+  }
+}
+
+bool MarketGenerator::Next(databento::MboMsg &msg) {
+  if (generated_ == total_messages()) {
+    return false;
+  }
+  if (generated_ < initial_messages_) {
+    InitialOrder(generated_, msg);
+  } else {
+    BodyMessage(first_message_ + generated_ - initial_messages_, msg);
+  }
+  ++generated_;
+  return true;
+}
+
+void MarketGenerator::InitialOrder(uint64_t index, databento::MboMsg &msg) {
+  // Instrument by instrument, alternating bid and ask one level further
+  // out each time
+  Instrument &instrument = instruments_[index / (2 * depth_)];
+  const int64_t level = static_cast<int64_t>(index % (2 * depth_) / 2 + 1);
+  const bool bid = index % 2 == 0;
+
+  Stamp(instrument, msg);
+  msg.action = databento::Action::Add;
+  msg.order_id = next_order_id_++;
+  msg.side = bid ? databento::Side::Bid : databento::Side::Ask;
+  msg.price = instrument.mid_price + (bid ? -level : level) * kPriceTick;
+  msg.size = static_cast<uint32_t>(instrument.rng.Between(1, 100));
+  instrument.live_orders.push_back(
+      {msg.order_id, msg.price, msg.size, static_cast<char>(msg.side)});
+}
+
+MarketGenerator::Mix MarketGenerator::MixAt(uint64_t index) const {
+  Mix mix;
+  switch (condition_) {
+  case MarketCondition::HighVolatility:
+    break;
+  case MarketCondition::FlashCrash:
+    if (InWindow(index, scenario_messages_ / 4, scenario_messages_ / 8)) {
+      mix.add = 10;
+      mix.cancel = 70;
+      mix.modify = 10;
+      mix.aggressive = 10;
+    }
+    break;
+  case MarketCondition::BookChurn:
+    mix.add = 10;
+    mix.cancel = 50;
+    mix.modify = 40;
+    mix.aggressive = 0;
+    mix.min_qty = 1;
+    mix.max_qty = 10;
+    break;
+  case MarketCondition::QuoteStuffing:
+    mix.add = 70;
+    mix.cancel = 20;
+    mix.modify = 0;
+    mix.aggressive = 10;
+    mix.min_qty = 1;
+    mix.max_qty = 5;
+    break;
+  case MarketCondition::LargeOrderImbalance:
+    if (InWindow(index, scenario_messages_ / 3, scenario_messages_ / 6)) {
+      mix.bid_bias = 90;
+      mix.max_qty *= 5;
+    }
+    break;
+  case MarketCondition::LiquidityDrain:
+    if (InWindow(index, scenario_messages_ / 2, scenario_messages_ / 8)) {
+      mix.add = 5;
+      mix.cancel = 90;
+      mix.modify = 5;
+      mix.aggressive = 0;
+    }
+    break;
+  case MarketCondition::PriceJump:
+    break;
+  }
+  return mix;
+}
+
+void MarketGenerator::BodyMessage(uint64_t index, databento::MboMsg &msg) {
+  Instrument &instrument = instruments_[rng_.Below(instruments_.size())];
+
+  if (condition_ == MarketCondition::FlashCrash &&
+      InWindow(index, scenario_messages_ / 4, scenario_messages_ / 8)) {
+    instrument.mid_price -= kFlashCrashDropPerMessage;
+  }
+  const uint64_t jump_interval =
+      std::max<uint64_t>(scenario_messages_ / 10, 1);
+  if (condition_ == MarketCondition::PriceJump && index > 0 &&
+      index % jump_interval == 0) {
+    instrument.mid_price += kPriceJump;
+  }
+
+  const Mix mix = MixAt(index);
+  Stamp(instrument, msg);
+
+  // Cancels and modifies need a live order, and fall through to an
+  // aggressive order without one
+  const bool has_live = !instrument.live_orders.empty();
+  const int action = static_cast<int>(instrument.rng.Below(100));
+  if (action < mix.add) {
+    if (instrument.live_orders.size() >= max_live_orders_) {
+      Cancel(instrument, msg);
+    } else {
+      Add(instrument, mix, msg);
+    }
+  } else if (action < mix.add + mix.cancel && has_live) {
+    Cancel(instrument, msg);
+  } else if (action < mix.add + mix.cancel + mix.modify && has_live) {
+    Modify(instrument, mix, msg);
+  } else {
+    Aggress(instrument, mix, msg);
+  }
+
+  // A flash crash moves the price on its own
+  if (condition_ != MarketCondition::FlashCrash) {
+    instrument.mid_price += instrument.rng.Between(-10, 10) * kPriceTick;
+  }
+  instrument.mid_price = std::clamp(instrument.mid_price, kInitialMidPrice / 2,
+                                    kInitialMidPrice * 2);
+}
+
+void MarketGenerator::Add(Instrument &instrument, const Mix &mix,
+                          databento::MboMsg &msg) {
+  Rng &rng = instrument.rng;
+  const bool bid = rng.Below(2) == 0;
+  msg.action = databento::Action::Add;
+  msg.order_id = next_order_id_++;
+  msg.size = static_cast<uint32_t>(rng.Between(mix.min_qty, mix.max_qty));
+  msg.side = bid ? databento::Side::Bid : databento::Side::Ask;
+
+  int64_t offset;
+  if (condition_ == MarketCondition::QuoteStuffing) {
+    offset = -kQuoteStuffingOffset - rng.Between(1, 10) * kPriceTick;
+  } else {
+    offset = rng.Between(1, 5) * kPriceTick;
+  }
+  msg.price = instrument.mid_price + (bid ? offset : -offset);
+
+  instrument.live_orders.push_back(
+      {msg.order_id, msg.price, msg.size, static_cast<char>(msg.side)});
+}
+
+void MarketGenerator::Cancel(Instrument &instrument, databento::MboMsg &msg) {
+  auto &live = instrument.live_orders;
+  const size_t i = instrument.rng.Below(live.size());
+  const LiveOrder order = live[i];
+  live[i] = live.back();
+  live.pop_back();
+
+  msg.action = databento::Action::Cancel;
+  msg.order_id = order.order_id;
+  msg.price = order.price;
+  msg.size = order.size;
+  msg.side = static_cast<databento::Side>(order.side);
+}
+
+void MarketGenerator::Modify(Instrument &instrument, const Mix &mix,
+                             databento::MboMsg &msg) {
+  Rng &rng = instrument.rng;
+  LiveOrder &order = instrument.live_orders[rng.Below(
+      instrument.live_orders.size())];
+  order.size = static_cast<uint32_t>(rng.Between(mix.min_qty, mix.max_qty));
+
+  msg.action = databento::Action::Modify;
+  msg.order_id = order.order_id;
+  msg.price = order.price;
+  msg.size = order.size;
+  msg.side = static_cast<databento::Side>(order.side);
+}
+
+void MarketGenerator::Aggress(Instrument &instrument, const Mix &mix,
+                              databento::MboMsg &msg) {
+  Rng &rng = instrument.rng;
+  const bool bid = static_cast<int>(rng.Below(100)) < mix.bid_bias;
+  msg.action = databento::Action::Add;
+  msg.order_id = next_order_id_++;
+  msg.size = static_cast<uint32_t>(
+      rng.Between(uint64_t{mix.max_qty} * 2, uint64_t{mix.max_qty} * 5));
+  msg.side = bid ? databento::Side::Bid : databento::Side::Ask;
+  // Priced through the mid to hit the other side. The order may not rest,
+  // so it is not tracked as live.
+  const int64_t offset = rng.Between(5, 15) * kPriceTick;
+  msg.price = instrument.mid_price + (bid ? offset : -offset);
+}
+
+void MarketGenerator::Stamp(Instrument &instrument, databento::MboMsg &msg) {
+  msg = {};
+  msg.hd.length = sizeof(databento::MboMsg) / 4;
+  msg.hd.rtype = databento::RType::Mbo;
+  msg.hd.instrument_id = instrument.id;
+  ts_ += 1 + rng_.Below(kMaxGapNanos);
+  msg.hd.ts_event = databento::UnixNanos{std::chrono::nanoseconds{ts_}};
+  msg.ts_recv =
+      databento::UnixNanos{std::chrono::nanoseconds{ts_ + kFeedLatencyNanos}};
+  msg.sequence = ++instrument.sequence;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "databento/record.hpp"
+
+#include "Rng.h"
+
+enum class MarketCondition {
+  HighVolatility,
+  FlashCrash,
+  BookChurn,
+  QuoteStuffing,
+  LargeOrderImbalance,
+  LiquidityDrain,
+  PriceJump
+};
+
+// Throws std::invalid_argument for an unknown name
+MarketCondition ParseMarketCondition(const std::string &name);
+
+// Generated when no condition is named; QuoteStuffing is left out
+inline constexpr std::array kDefaultMarketConditions = {
+    "HighVolatility",      "FlashCrash",     "BookChurn",
+    "LargeOrderImbalance", "LiquidityDrain", "PriceJump",
+};
+
+// Synthetic MBO stream for stress-testing the books under a market
+// condition. Each instrument starts from a book `depth` levels deep on
+// either side, followed by `messages` adds, cancels, modifies and
+// aggressive orders spread randomly across the instruments.
+//
+// Output depends only on the Config: the random numbers come from Rng
+// rather than std::random_device and the std:: distributions, and
+// timestamps are simulated, so the same seed reproduces a file bit for bit.
+// Messages are produced one at a time and the only state kept is each
+// instrument's live orders, in a vector where a random one is picked and
+// removed in O(1), so the message count can run into the billions.
+class MarketGenerator {
+public:
+  // 2024-01-02 14:30:00 UTC
+  static constexpr uint64_t kDefaultStartTs = 1704205800000000000;
+  // Gap between consecutive messages is uniform in [1, kMaxGapNanos]
+  static constexpr uint64_t kMaxGapNanos = 2000;
+
+  struct Config {
+    MarketCondition condition = MarketCondition::HighVolatility;
+    uint64_t seed = 42;
+    uint64_t messages = 500000; // Not counting the initial books
+    uint32_t instruments = 1;
+    uint32_t depth = 100;
+    // Per instrument. At the cap, adds turn into cancels, which bounds the
+    // generator's memory however long it runs.
+    size_t max_live_orders = 1000000;
+    uint64_t start_ts = kDefaultStartTs;
+
+    // For one shard of a scenario split across files: the position of its
+    // first message within the scenario and the scenario's length, which
+    // place it in the condition's phases. Each shard starts from its own
+    // initial books; its start_ts, first_order_id and first_sequence should
+    // follow on from the previous shard.
+    uint64_t first_message = 0;
+    uint64_t scenario_messages = 0; // 0 when the scenario is unsharded
+    uint64_t first_order_id = 1;
+    uint32_t first_sequence = 1; // Of each instrument's first message
+  };
+
+  explicit MarketGenerator(const Config &config);
+
+  // Fills msg with the next message, or returns false after the last one
+  bool Next(databento::MboMsg &msg);
+
+  uint64_t total_messages() const { return initial_messages_ + messages_; }
+  // Instrument ids run from 1 to instruments
+  uint32_t instruments() const {
+    return static_cast<uint32_t>(instruments_.size());
+  }
+
+private:
+  struct LiveOrder {
+    uint64_t order_id;
+    int64_t price;
+    uint32_t size;
+    char side;
+  };
+
+  struct Instrument {
+    uint32_t id;
+    int64_t mid_price;
+    uint32_t sequence = 0;
+    Rng rng;
+    std::vector<LiveOrder> live_orders;
+  };
+
+  // Action probabilities in percent, summing to 100, and sizes for one
+  // message of the condition's scenario
+  struct Mix {
+    int add = 25;
+    int cancel = 30;
+    int modify = 20;
+    int aggressive = 25;
+    uint32_t min_qty = 1;
+    uint32_t max_qty = 100;
+    int bid_bias = 50; // Chance of an aggressive order being a buy
+  };
+
+  // Indexes count body messages from the start of the scenario
+  Mix MixAt(uint64_t index) const;
+
+  void InitialOrder(uint64_t index, databento::MboMsg &msg);
+  void BodyMessage(uint64_t index, databento::MboMsg &msg);
+  void Add(Instrument &instrument, const Mix &mix, databento::MboMsg &msg);
+  void Cancel(Instrument &instrument, databento::MboMsg &msg);
+  void Modify(Instrument &instrument, const Mix &mix,
+              databento::MboMsg &msg);
+  void Aggress(Instrument &instrument, const Mix &mix,
+               databento::MboMsg &msg);
+  // Header, timestamps and sequence common to every message
+  void Stamp(Instrument &instrument, databento::MboMsg &msg);
+
+  MarketCondition condition_;
+  uint64_t messages_;
+  uint64_t first_message_;
+  uint64_t scenario_messages_;
+  uint32_t depth_;
+  size_t max_live_orders_;
+  uint64_t initial_messages_;
+
+  // Picks the instrument and arrival time of every message
+  Rng rng_;
+  std::vector<Instrument> instruments_;
+  uint64_t generated_ = 0;
+  uint64_t next_order_id_;
+  uint64_t ts_;
+};
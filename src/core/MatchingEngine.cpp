@@ -0,0 +1,265 @@
+#include "MatchingEngine.h"
+
+#include <algorithm>
+#include <type_traits>
+
+#include "BookUtils.h"
+
+namespace {
+
+bool Crosses(char side, Price limit_price, Price level_price) {
+  return side == 'B' ? level_price <= limit_price : level_price >= limit_price;
+}
+
+} // namespace
+
+MatchingEngine::MatchingEngine(size_t max_orders, size_t report_capacity)
+    : bids(max_orders), asks(max_orders), order_pool(max_orders),
+      list_pool(max_orders) {
+  orders.reserve(max_orders);
+  reports.reserve(report_capacity);
+}
+
+Price MatchingEngine::GetBestBid() const { return book_utils::GetBest(bids); }
+
+Price MatchingEngine::GetBestAsk() const { return book_utils::GetBest(asks); }
+
+std::span<const ExecutionReport>
+MatchingEngine::SubmitLimit(OrderId order_id, char side, Price price,
+                            Quantity quantity, TimeInForce tif) {
+  return Submit(order_id, side, price, quantity, tif, false);
+}
+
+std::span<const ExecutionReport>
+MatchingEngine::SubmitMarket(OrderId order_id, char side, Quantity quantity) {
+  return Submit(order_id, side, kMarketPrice, quantity,
+                TimeInForce::ImmediateOrCancel, true);
+}
+
+std::span<const ExecutionReport> MatchingEngine::Cancel(OrderId order_id) {
+  reports.clear();
+
+  auto map_it = orders.find(order_id);
+  if (map_it == orders.end()) {
+    Report(ExecType::Rejected, order_id, 0, 0, 0, 0, 0);
+    return Reports();
+  }
+
+  Order *order = map_it->second;
+  Report(ExecType::Cancelled, order_id, 0, order->side, order->price,
+         order->quantity, 0);
+  Remove(order);
+  return Reports();
+}
+
+std::span<const ExecutionReport>
+MatchingEngine::Replace(OrderId order_id, Price price, Quantity quantity) {
+  reports.clear();
+
+  auto map_it = orders.find(order_id);
+  if (map_it == orders.end() || quantity == 0) {
+    Report(ExecType::Rejected, order_id, 0, 0, price, quantity, 0);
+    return Reports();
+  }
+
+  Order *order = map_it->second;
+  const char side = order->side;
+  Report(ExecType::Replaced, order_id, 0, side, price, quantity, quantity);
+
+  if (price == order->price && quantity <= order->quantity) {
+    order->list->total_quantity -= order->quantity - quantity;
+    order->quantity = quantity;
+    return Reports();
+  }
+
+  Remove(order);
+  Execute(order_id, side, price, quantity, TimeInForce::GoodTillCancel, false);
+  return Reports();
+}
+
+std::span<const ExecutionReport>
+MatchingEngine::Submit(OrderId order_id, char side, Price price,
+                       Quantity quantity, TimeInForce tif, bool is_market) {
+  reports.clear();
+
+  if (quantity == 0 || (side != 'B' && side != 'A') ||
+      orders.contains(order_id)) {
+    Report(ExecType::Rejected, order_id, 0, side, price, quantity, 0);
+    return Reports();
+  }
+
+  Report(ExecType::New, order_id, 0, side, price, quantity, quantity);
+
+  if (tif == TimeInForce::FillOrKill) {
+    const uint64_t available =
+        side == 'B' ? Available(asks, price, quantity, is_market)
+                    : Available(bids, price, quantity, is_market);
+    if (available < quantity) {
+      Report(ExecType::Cancelled, order_id, 0, side, price, quantity, 0);
+      return Reports();
+    }
+  }
+
+  Execute(order_id, side, price, quantity, tif, is_market);
+  return Reports();
+}
+
+void MatchingEngine::Execute(OrderId order_id, char side, Price price,
+                             Quantity quantity, TimeInForce tif,
+                             bool is_market) {
+  const Quantity remaining =
+      side == 'B' ? Sweep(asks, order_id, side, price, quantity, is_market)
+                  : Sweep(bids, order_id, side, price, quantity, is_market);
+  if (remaining == 0) {
+    return;
+  }
+
+  if (is_market || tif != TimeInForce::GoodTillCancel) {
+    Report(ExecType::Cancelled, order_id, 0, side, price, remaining, 0);
+  } else {
+    Rest(order_id, side, price, remaining);
+  }
+}
+
+template <typename Book>
+Quantity MatchingEngine::Sweep(Book &book, OrderId order_id, char side,
+                               Price limit_price, Quantity quantity,
+                               bool is_market) {
+  auto level_it = book.begin();
+  for (; level_it != book.end() && quantity > 0; ++level_it) {
+    const Price level_price = level_it->first;
+    if (!is_market && !Crosses(side, limit_price, level_price)) {
+      break;
+    }
+
+    OrderList *list = level_it->second;
+    while (list->head && quantity > 0) {
+      Order *resting = list->head;
+      const Quantity fill_qty = std::min(quantity, resting->quantity);
+      quantity -= fill_qty;
+      resting->quantity -= fill_qty;
+      list->total_quantity -= fill_qty;
+
+      Report(quantity == 0 ? ExecType::Fill : ExecType::PartialFill, order_id,
+             resting->order_id, side, level_price, fill_qty, quantity);
+      Report(resting->quantity == 0 ? ExecType::Fill : ExecType::PartialFill,
+             resting->order_id, order_id, resting->side, level_price,
+             fill_qty, resting->quantity);
+
+      if (resting->quantity == 0) {
+        RemoveOrder(resting);
+        orders.erase(resting->order_id);
+        order_pool.release(resting);
+      }
+    }
+
+    // A level that still has orders is where the sweep stops
+    if (list->head != nullptr) {
+      break;
+    }
+    list_pool.release(list);
+  }
+
+  // The emptied levels are all at the front, so drop them in one go
+  book.erase(book.begin(), level_it);
+  return quantity;
+}
+
+template <typename Book>
+uint64_t MatchingEngine::Available(const Book &book, Price limit_price,
+                                   Quantity quantity, bool is_market) const {
+  const char side = std::is_same_v<Book, AskBook> ? 'B' : 'A';
+  uint64_t available = 0;
+  for (const auto &[level_price, list] : book) {
+    if (available >= quantity ||
+        (!is_market && !Crosses(side, limit_price, level_price))) {
+      break;
+    }
+    available += book_utils::count_size(list);
+  }
+  return available;
+}
+
+void MatchingEngine::Rest(OrderId order_id, char side, Price price,
+                          Quantity quantity) {
+  Order *order = order_pool.acquire();
+  order->order_id = order_id;
+  order->price = price;
+  order->quantity = quantity;
+  order->side = side;
+  order->next = nullptr;
+  order->prev = nullptr;
+
+  auto rest_on = [&](auto &book) {
+    auto it = book.find(price);
+    if (it == book.end()) {
+      OrderList *new_list = list_pool.acquire();
+      new_list->head = nullptr;
+      new_list->tail = nullptr;
+      new_list->total_quantity = 0;
+      new_list->order_count = 0;
+      it = book.emplace(price, new_list).first;
+    }
+    AppendOrder(it->second, order);
+  };
+  if (side == 'B') {
+    rest_on(bids);
+  } else {
+    rest_on(asks);
+  }
+  orders.emplace(order_id, order);
+}
+
+void MatchingEngine::Remove(Order *order) {
+  RemoveOrder(order);
+  orders.erase(order->order_id);
+
+  if (order->list->head == nullptr) {
+    if (order->side == 'B') {
+      bids.erase(bids.find(order->price));
+    } else {
+      asks.erase(asks.find(order->price));
+    }
+    list_pool.release(order->list);
+  }
+
+  order_pool.release(order);
+}
+
+void MatchingEngine::AppendOrder(OrderList *list, Order *order) {
+  order->list = list;
+  ++list->order_count;
+  list->total_quantity += order->quantity;
+  if (list->tail == nullptr) {
+    list->head = order;
+    list->tail = order;
+  } else {
+    list->tail->next = order;
+    order->prev = list->tail;
+    list->tail = order;
+  }
+}
+
+void MatchingEngine::RemoveOrder(Order *order) {
+  --order->list->order_count;
+  order->list->total_quantity -= order->quantity;
+
+  if (order->prev) {
+    order->prev->next = order->next;
+  } else {
+    order->list->head = order->next;
+  }
+
+  if (order->next) {
+    order->next->prev = order->prev;
+  } else {
+    order->list->tail = order->prev;
+  }
+}
+
+void MatchingEngine::Report(ExecType type, OrderId order_id,
+                            OrderId contra_order_id, char side, Price price,
+                            Quantity quantity, Quantity leaves_quantity) {
+  reports.push_back(ExecutionReport{type, order_id, contra_order_id, side,
+                                    price, quantity, leaves_quantity});
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "FlatMap.h"
+#include "ObjectPool.h"
+#include "Order.h"
+
+enum class TimeInForce : uint8_t {
+  GoodTillCancel,    // Any remainder rests on the book
+  ImmediateOrCancel, // Any remainder is cancelled
+  FillOrKill,        // Fills completely or not at all
+};
+
+enum class ExecType : uint8_t {
+  New,
+  PartialFill,
+  Fill,
+  Cancelled,
+  Replaced,
+  Rejected,
+};
+
+struct ExecutionReport {
+  ExecType type;
+  OrderId order_id;
+  OrderId contra_order_id; // Other side of a fill, 0 otherwise
+  char side;
+  // Execution price and quantity for fills, the order's own otherwise
+  Price price;
+  Quantity quantity;
+  Quantity leaves_quantity; // Quantity still open after this report
+};
+
+// Order-entry front end on the same intrusive level lists and object pools
+// as the books. Incoming orders sweep as many levels as they cross in a
+// single pass. Every call returns its execution reports as a view into a
+// buffer owned by the engine, valid until the next call.
+class MatchingEngine {
+public:
+  explicit MatchingEngine(size_t max_orders = 100000,
+                          size_t report_capacity = 4096);
+
+  std::span<const ExecutionReport>
+  SubmitLimit(OrderId order_id, char side, Price price, Quantity quantity,
+              TimeInForce tif = TimeInForce::GoodTillCancel);
+  // Sweeps at any price; whatever cannot be filled is cancelled
+  std::span<const ExecutionReport> SubmitMarket(OrderId order_id, char side,
+                                                Quantity quantity);
+  std::span<const ExecutionReport> Cancel(OrderId order_id);
+  // Reducing quantity at the same price keeps queue priority; any other
+  // change re-enters the order at the back of its new level, where it may
+  // trade.
+  std::span<const ExecutionReport> Replace(OrderId order_id, Price price,
+                                           Quantity quantity);
+
+  Price GetBestBid() const;
+  Price GetBestAsk() const;
+  size_t OrderCount() const { return orders.size(); }
+
+private:
+  using BidBook = FlatMap<Price, OrderList *, std::greater<Price>>;
+  using AskBook = FlatMap<Price, OrderList *, std::less<Price>>;
+  using OrderMap = std::unordered_map<OrderId, Order *>;
+
+  static constexpr Price kMarketPrice = 0;
+
+  std::span<const ExecutionReport> Submit(OrderId order_id, char side,
+                                          Price price, Quantity quantity,
+                                          TimeInForce tif, bool is_market);
+  // Matches an accepted order and rests, or cancels, the remainder
+  void Execute(OrderId order_id, char side, Price price, Quantity quantity,
+               TimeInForce tif, bool is_market);
+
+  // Matches against the opposite side while it crosses limit_price, and
+  // returns the quantity left unfilled
+  template <typename Book>
+  Quantity Sweep(Book &book, OrderId order_id, char side, Price limit_price,
+                 Quantity quantity, bool is_market);
+
+  // Quantity available on the opposite side at or better than limit_price,
+  // stopping as soon as it reaches quantity. Summed in 64 bits, since the
+  // levels together can hold more than a Quantity.
+  template <typename Book>
+  uint64_t Available(const Book &book, Price limit_price, Quantity quantity,
+                     bool is_market) const;
+
+  void Rest(OrderId order_id, char side, Price price, Quantity quantity);
+  void Remove(Order *order);
+
+  void AppendOrder(OrderList *list, Order *order);
+  void RemoveOrder(Order *order);
+
+  void Report(ExecType type, OrderId order_id, OrderId contra_order_id,
+              char side, Price price, Quantity quantity,
+              Quantity leaves_quantity);
+  std::span<const ExecutionReport> Reports() const { return reports; }
+
+  BidBook bids;
+  AskBook asks;
+  OrderMap orders;
+
+  ObjectPool<Order> order_pool;
+  ObjectPool<OrderList> list_pool;
+
+  // Cleared at the start of every call; only grows if a single sweep
+  // produces more reports than the initial capacity
+  std::vector<ExecutionReport> reports;
+};
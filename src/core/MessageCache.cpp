@@ -0,0 +1,275 @@
+#include "MessageCache.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+
+#include "ParallelDbnReader.h"
+
+namespace message_cache {
+
+namespace {
+
+constexpr size_t kColumnAlignment = 64;
+
+struct Layout {
+  size_t order_id, price, ts_event, ts_recv, size, sequence, instrument_id,
+      action, side;
+  size_t total;
+};
+
+Layout LayoutFor(uint64_t count) {
+  Layout layout;
+  size_t offset = sizeof(Header);
+  auto column = [&](size_t element_size) {
+    const size_t start = offset;
+    offset += element_size * count;
+    offset = (offset + kColumnAlignment - 1) & ~(kColumnAlignment - 1);
+    return start;
+  };
+  layout.order_id = column(sizeof(OrderId));
+  layout.price = column(sizeof(Price));
+  layout.ts_event = column(sizeof(uint64_t));
+  layout.ts_recv = column(sizeof(uint64_t));
+  layout.size = column(sizeof(Quantity));
+  layout.sequence = column(sizeof(uint32_t));
+  layout.instrument_id = column(sizeof(uint32_t));
+  layout.action = column(sizeof(char));
+  layout.side = column(sizeof(char));
+  layout.total = offset;
+  return layout;
+}
+
+std::vector<std::byte> Encode(std::span<const databento::MboMsg> messages) {
+  const uint64_t count = messages.size();
+  const Layout layout = LayoutFor(count);
+  std::vector<std::byte> buffer(layout.total);
+  std::byte *base = buffer.data();
+
+  Header header;
+  header.count = count;
+  std::memcpy(base, &header, sizeof(header));
+
+  auto *order_id = reinterpret_cast<OrderId *>(base + layout.order_id);
+  auto *price = reinterpret_cast<Price *>(base + layout.price);
+  auto *ts_event = reinterpret_cast<uint64_t *>(base + layout.ts_event);
+  auto *ts_recv = reinterpret_cast<uint64_t *>(base + layout.ts_recv);
+  auto *size = reinterpret_cast<Quantity *>(base + layout.size);
+  auto *sequence = reinterpret_cast<uint32_t *>(base + layout.sequence);
+  auto *instrument_id =
+      reinterpret_cast<uint32_t *>(base + layout.instrument_id);
+  auto *action = reinterpret_cast<char *>(base + layout.action);
+  auto *side = reinterpret_cast<char *>(base + layout.side);
+
+  for (uint64_t i = 0; i < count; ++i) {
+    const databento::MboMsg &msg = messages[i];
+    order_id[i] = msg.order_id;
+    price[i] = msg.price;
+    ts_event[i] = msg.hd.ts_event.time_since_epoch().count();
+    ts_recv[i] = msg.ts_recv.time_since_epoch().count();
+    size[i] = msg.size;
+    sequence[i] = msg.sequence;
+    instrument_id[i] = msg.hd.instrument_id;
+    action[i] = static_cast<char>(msg.action);
+    side[i] = static_cast<char>(msg.side);
+  }
+  return buffer;
+}
+
+} // namespace
+
+std::string PathFor(const std::string &dbn_path) { return dbn_path + ".mcol"; }
+
+void Write(const std::string &path,
+           std::span<const databento::MboMsg> messages) {
+  const std::vector<std::byte> buffer = Encode(messages);
+  // Written beside the cache and renamed over it, so a process mapping the
+  // old cache keeps its copy and nothing ever sees a partial file
+  const std::string temp_path = path + ".tmp." + std::to_string(::getpid());
+  {
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      throw std::runtime_error("Could not open message cache for writing: " +
+                               temp_path);
+    }
+    out.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+    out.close();
+    if (!out) {
+      std::filesystem::remove(temp_path);
+      throw std::runtime_error("Failed writing message cache: " + temp_path);
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temp_path, path, error);
+  if (error) {
+    std::filesystem::remove(temp_path);
+    throw std::runtime_error("Could not replace message cache: " + path +
+                             ": " + error.message());
+  }
+}
+
+View::View(const std::string &path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Could not open message cache: " + path);
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(Header)) {
+    ::close(fd);
+    throw std::runtime_error("Message cache truncated: " + path);
+  }
+  mapping_size_ = st.st_size;
+  // Populated up front so the replay loop never takes a page fault
+  mapping_ = ::mmap(nullptr, mapping_size_, PROT_READ,
+                    MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  ::close(fd);
+  if (mapping_ == MAP_FAILED) {
+    mapping_ = nullptr;
+    throw std::runtime_error("Could not map message cache: " + path);
+  }
+
+  try {
+    Attach(static_cast<const std::byte *>(mapping_), mapping_size_);
+  } catch (...) {
+    Release();
+    throw;
+  }
+}
+
+View::View(std::span<const databento::MboMsg> messages)
+    : storage_{Encode(messages)} {
+  Attach(storage_.data(), storage_.size());
+}
+
+View::~View() { Release(); }
+
+View::View(View &&other) noexcept { *this = std::move(other); }
+
+View &View::operator=(View &&other) noexcept {
+  if (this != &other) {
+    Release();
+    mapping_ = std::exchange(other.mapping_, nullptr);
+    mapping_size_ = std::exchange(other.mapping_size_, 0);
+    // Moving a vector keeps its buffer, so the column pointers stay valid
+    storage_ = std::move(other.storage_);
+    count_ = std::exchange(other.count_, 0);
+    order_id_ = other.order_id_;
+    price_ = other.price_;
+    ts_event_ = other.ts_event_;
+    ts_recv_ = other.ts_recv_;
+    size_ = other.size_;
+    sequence_ = other.sequence_;
+    instrument_id_ = other.instrument_id_;
+    action_ = other.action_;
+    side_ = other.side_;
+  }
+  return *this;
+}
+
+void View::Release() {
+  if (mapping_ != nullptr) {
+    ::munmap(mapping_, mapping_size_);
+    mapping_ = nullptr;
+  }
+  storage_.clear();
+  count_ = 0;
+}
+
+void View::Attach(const std::byte *data, size_t size) {
+  Header header;
+  std::memcpy(&header, data, sizeof(header));
+  if (header.magic != kMagic) {
+    throw std::runtime_error("Not a message cache");
+  }
+  if (header.version != kVersion) {
+    throw std::runtime_error("Unsupported message cache version");
+  }
+  const Layout layout = LayoutFor(header.count);
+  if (size < layout.total) {
+    throw std::runtime_error("Message cache truncated");
+  }
+
+  count_ = header.count;
+  order_id_ = reinterpret_cast<const OrderId *>(data + layout.order_id);
+  price_ = reinterpret_cast<const Price *>(data + layout.price);
+  ts_event_ = reinterpret_cast<const uint64_t *>(data + layout.ts_event);
+  ts_recv_ = reinterpret_cast<const uint64_t *>(data + layout.ts_recv);
+  size_ = reinterpret_cast<const Quantity *>(data + layout.size);
+  sequence_ = reinterpret_cast<const uint32_t *>(data + layout.sequence);
+  instrument_id_ =
+      reinterpret_cast<const uint32_t *>(data + layout.instrument_id);
+  action_ = reinterpret_cast<const char *>(data + layout.action);
+  side_ = reinterpret_cast<const char *>(data + layout.side);
+}
+
+databento::MboMsg View::operator[](size_t i) const {
+  databento::MboMsg msg{};
+  msg.hd.length = sizeof(databento::MboMsg) / 4;
+  msg.hd.rtype = databento::RType::Mbo;
+  msg.hd.instrument_id = instrument_id_[i];
+  msg.hd.ts_event =
+      databento::UnixNanos{std::chrono::nanoseconds{ts_event_[i]}};
+  msg.order_id = order_id_[i];
+  msg.price = price_[i];
+  msg.size = size_[i];
+  msg.action = static_cast<databento::Action>(action_[i]);
+  msg.side = static_cast<databento::Side>(side_[i]);
+  msg.ts_recv = databento::UnixNanos{std::chrono::nanoseconds{ts_recv_[i]}};
+  msg.sequence = sequence_[i];
+  return msg;
+}
+
+View Open(const std::string &dbn_path, bool direct_io) {
+  const std::string cache_path = PathFor(dbn_path);
+  if (std::filesystem::exists(cache_path) &&
+      std::filesystem::last_write_time(cache_path) >=
+          std::filesystem::last_write_time(dbn_path)) {
+    return View{cache_path};
+  }
+
+  std::vector<databento::MboMsg> messages;
+  ParallelDbnReader reader{dbn_path, 0, 8, direct_io};
+  while (const databento::Record *record = reader.NextRecord()) {
+    if (record->RType() == databento::RType::Mbo) {
+      messages.push_back(record->Get<databento::MboMsg>());
+    }
+  }
+  Write(cache_path, messages);
+  return View{cache_path};
+}
+
+std::array<uint64_t, 256> ActionHistogram(const View &view) {
+  // Runs of the same action would otherwise serialise on one counter, so
+  // four interleaved sub-histograms are summed at the end
+  std::array<std::array<uint64_t, 256>, 4> partial{};
+  const std::span<const char> actions = view.action();
+  const auto *data = reinterpret_cast<const unsigned char *>(actions.data());
+  size_t i = 0;
+  for (; i + 4 <= actions.size(); i += 4) {
+    ++partial[0][data[i]];
+    ++partial[1][data[i + 1]];
+    ++partial[2][data[i + 2]];
+    ++partial[3][data[i + 3]];
+  }
+  for (; i < actions.size(); ++i) {
+    ++partial[0][data[i]];
+  }
+
+  std::array<uint64_t, 256> histogram{};
+  for (size_t c = 0; c < histogram.size(); ++c) {
+    histogram[c] =
+        partial[0][c] + partial[1][c] + partial[2][c] + partial[3][c];
+  }
+  return histogram;
+}
+
+} // namespace message_cache
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "databento/record.hpp"
+
+#include "Order.h"
+
+// Pre-decoded, columnar copy of the MBO messages of a DBN file, so repeated
+// benchmark runs can mmap it instead of decoding the DBN file every time.
+// It saves load time only: the books take whole MboMsgs, so the replay
+// loops reassemble one per message from the columns, or copy them back
+// into a vector before the timed loop. Only whole-column passes such as
+// ActionHistogram read the columns as they are.
+//
+// Layout (native endianness): Header, then one array per column, each
+// starting on a 64 byte boundary, in the order order_id, price, ts_event,
+// ts_recv, size, sequence, instrument_id, action, side. Only the fields the
+// books read are kept.
+namespace message_cache {
+
+constexpr uint32_t kMagic = 0x4c4f434d; // "MCOL"
+constexpr uint32_t kVersion = 1;
+
+struct alignas(64) Header {
+  uint32_t magic = kMagic;
+  uint32_t version = kVersion;
+  uint64_t count = 0;
+};
+
+// Side-car cache file for a DBN file
+std::string PathFor(const std::string &dbn_path);
+
+// Converts messages to the columnar layout and writes it to path, through
+// a temporary file renamed over it
+void Write(const std::string &path,
+           std::span<const databento::MboMsg> messages);
+
+// Columns over either an mmap'd cache file or an in-memory copy. Indexing
+// reassembles an MboMsg, so the replay loops can take a View wherever they
+// took a vector of messages.
+class View {
+public:
+  View() = default;
+  explicit View(const std::string &path);
+  explicit View(std::span<const databento::MboMsg> messages);
+  ~View();
+
+  View(View &&other) noexcept;
+  View &operator=(View &&other) noexcept;
+
+  size_t size() const { return count_; }
+  bool empty() const { return count_ == 0; }
+
+  std::span<const OrderId> order_id() const { return {order_id_, count_}; }
+  std::span<const Price> price() const { return {price_, count_}; }
+  std::span<const uint64_t> ts_event() const { return {ts_event_, count_}; }
+  std::span<const uint64_t> ts_recv() const { return {ts_recv_, count_}; }
+  std::span<const Quantity> quantity() const { return {size_, count_}; }
+  std::span<const uint32_t> sequence() const { return {sequence_, count_}; }
+  std::span<const uint32_t> instrument_id() const {
+    return {instrument_id_, count_};
+  }
+  std::span<const char> action() const { return {action_, count_}; }
+  std::span<const char> side() const { return {side_, count_}; }
+
+  databento::MboMsg operator[](size_t i) const;
+
+  class Iterator {
+  public:
+    Iterator(const View *view, size_t i) : view_{view}, i_{i} {}
+    databento::MboMsg operator*() const { return (*view_)[i_]; }
+    Iterator &operator++() {
+      ++i_;
+      return *this;
+    }
+    bool operator!=(const Iterator &other) const { return i_ != other.i_; }
+
+  private:
+    const View *view_;
+    size_t i_;
+  };
+
+  Iterator begin() const { return {this, 0}; }
+  Iterator end() const { return {this, count_}; }
+
+private:
+  void Attach(const std::byte *data, size_t size);
+  void Release();
+
+  // Set when the columns live in a mapping rather than in storage_
+  void *mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+  std::vector<std::byte> storage_;
+
+  size_t count_ = 0;
+  const OrderId *order_id_ = nullptr;
+  const Price *price_ = nullptr;
+  const uint64_t *ts_event_ = nullptr;
+  const uint64_t *ts_recv_ = nullptr;
+  const Quantity *size_ = nullptr;
+  const uint32_t *sequence_ = nullptr;
+  const uint32_t *instrument_id_ = nullptr;
+  const char *action_ = nullptr;
+  const char *side_ = nullptr;
+};
+
+// Maps the cache for a DBN file, first building it if it is missing or
+// older than the DBN file. direct_io reads the DBN file with O_DIRECT
+// while building, as for ParallelDbnReader.
+View Open(const std::string &dbn_path, bool direct_io = false);
+
+// Message count per action character, from a single pass over the action
+// column
+std::array<uint64_t, 256> ActionHistogram(const View &view);
+
+} // namespace message_cache
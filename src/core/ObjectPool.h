@@ -1,24 +1,19 @@
 #pragma once
 
+#include <algorithm>
+#include <memory>
 #include <vector>
 
-// A simple object pool for arbitrary types
+// A simple object pool for arbitrary types. It starts with room for size
+// objects and, whenever they are all in use, adds a chunk as large as
+// everything it holds so far. Objects never move once handed out.
 template <typename T> class ObjectPool {
 public:
-  ObjectPool(size_t size = 100000) {
-    pool_.reserve(size);
-    for (size_t i = 0; i < size; ++i) {
-      pool_.emplace_back();
-    }
-    free_list_.reserve(size);
-    for (size_t i = 0; i < size; ++i) {
-      free_list_.push_back(&pool_[i]);
-    }
-  }
+  ObjectPool(size_t size = 100000) { Grow(std::max<size_t>(size, 1)); }
 
   T *acquire() {
     if (free_list_.empty()) {
-      throw std::runtime_error("ObjectPool exhausted");
+      Grow(capacity_);
     }
     T *obj = free_list_.back();
     free_list_.pop_back();
@@ -27,7 +22,20 @@ public:
 
   void release(T *obj) { free_list_.push_back(obj); }
 
+  size_t capacity() const { return capacity_; }
+
 private:
-  std::vector<T> pool_;
+  void Grow(size_t count) {
+    chunks_.push_back(std::make_unique<T[]>(count));
+    T *chunk = chunks_.back().get();
+    capacity_ += count;
+    free_list_.reserve(capacity_);
+    for (size_t i = 0; i < count; ++i) {
+      free_list_.push_back(&chunk[i]);
+    }
+  }
+
+  std::vector<std::unique_ptr<T[]>> chunks_;
   std::vector<T *> free_list_;
+  size_t capacity_ = 0;
 };
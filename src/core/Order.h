@@ -1,5 +1,9 @@
 #pragma once
 
+#include <cstdint>
+
+#include "FenwickTree.h"
+
 using Price = int64_t;
 using Quantity = uint32_t;
 using OrderId = uint64_t;
@@ -16,10 +20,34 @@ struct Order {
   Order *prev = nullptr;
   Order *next = nullptr;
   OrderList *list = nullptr; // Pointer back to the list it's in
+  uint32_t slot = 0;         // Arrival slot in its list's queue index
+};
+
+// Quantity and number of orders over a range of arrival slots
+struct QueueTotals {
+  int64_t quantity = 0;
+  int64_t count = 0;
+
+  QueueTotals &operator+=(const QueueTotals &other) {
+    quantity += other.quantity;
+    count += other.count;
+    return *this;
+  }
 };
 
 // Represents the head and tail of an intrusive list of orders
 struct OrderList {
   Order *head = nullptr;
   Order *tail = nullptr;
+  // Totals over the orders in the list, kept up to date as orders are
+  // appended, removed and filled so a level never needs to be walked
+  uint64_t total_quantity = 0;
+  uint32_t order_count = 0;
+  // Each order's quantity at the slot it was given on arrival, so the
+  // quantity and orders ahead of it are a prefix sum. Slots are handed out
+  // in queue order and renumbered when they run out. Only books with
+  // BookFeatures::QueuePositions use it; it never allocates otherwise, and
+  // a pooled list keeps its storage for the next level it holds.
+  FenwickTree<QueueTotals> queue;
+  uint32_t next_slot = 0;
 };
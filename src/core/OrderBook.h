@@ -1,45 +1,29 @@
 #pragma once
 
-#include <iostream>
+#include <functional>
 #include <map>
 #include <unordered_map>
-#include <vector>
 
-#include "ObjectPool.h"
-#include "Order.h"
-#include "databento/record.hpp"
+#include "Book.h"
 
-class OrderBook {
-public:
-  OrderBook();
-
-  void ProcessMboMsg(const databento::MboMsg &msg);
-
-  void AddOrder(const databento::MboMsg &msg);
-  void ModifyOrder(const databento::MboMsg &msg);
-  void CancelOrder(const databento::MboMsg &msg);
-  void CancelOrderById(OrderId order_id);
-  void TradeOrder(const databento::MboMsg &msg);
-
-  Price GetBestBid() const;
-  Price GetBestAsk() const;
-
-  void Snapshot(std::ostream &os) const;
-
-private:
+// Levels in std::map and orders in std::unordered_map, allocating from the
+// global heap
+struct MapContainers {
   using BidBook = std::map<Price, OrderList *, std::greater<Price>>;
   using AskBook = std::map<Price, OrderList *, std::less<Price>>;
   using OrderMap = std::unordered_map<OrderId, Order *>;
 
-  void AppendOrder(OrderList *list, Order *order);
-  void RemoveOrder(Order *order);
+  struct Arena {};
+
+  template <typename Container> static Container Make(Arena &) {
+    return Container{};
+  }
+};
 
-  void Match();
+template <BookEventSink EventSink = NullEventSink,
+          BookFeatures Features = BookFeatures::None>
+using BasicOrderBook = BasicBook<MapContainers, EventSink, Features>;
 
-  BidBook bids;
-  AskBook asks;
-  OrderMap orders;
+extern template class BasicBook<MapContainers, NullEventSink>;
 
-  ObjectPool<Order> order_pool;
-  ObjectPool<OrderList> list_pool;
-};
+using OrderBook = BasicOrderBook<>;
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+
+// Releases messages at their original ts_recv spacing, divided by a speed
+// factor, so a replay sees the same idle gaps and bursts as the live feed.
+// Times are steady_clock nanoseconds.
+class Pacer {
+public:
+  // Waits shorter than this are spun rather than slept, since a sleep can
+  // overshoot by the kernel's timer slack (50us by default)
+  static constexpr uint64_t kSpinNanos = 200000;
+
+  // A speed of 0 is unpaced: every message is due at once
+  explicit Pacer(double speed) : speed_{speed} {
+    if (!(speed >= 0)) {
+      throw std::invalid_argument("Replay speed must not be negative");
+    }
+  }
+
+  static uint64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  static void WaitUntil(uint64_t deadline) {
+    const uint64_t now = Now();
+    if (deadline > now + kSpinNanos) {
+      std::this_thread::sleep_for(
+          std::chrono::nanoseconds(deadline - now - kSpinNanos));
+    }
+    while (Now() < deadline) {
+    }
+  }
+
+  // When a message received at ts_recv is due. The first call anchors the
+  // schedule to the current time.
+  uint64_t ReleaseTime(uint64_t ts_recv) {
+    if (!started_) {
+      started_ = true;
+      first_ts_recv_ = ts_recv;
+      start_ = Now();
+    }
+    if (ts_recv <= first_ts_recv_ || speed_ == 0) {
+      return start_;
+    }
+    return start_ + static_cast<uint64_t>((ts_recv - first_ts_recv_) / speed_);
+  }
+
+  // Waits for the message's release time and returns it
+  uint64_t Release(uint64_t ts_recv) {
+    const uint64_t release = ReleaseTime(ts_recv);
+    WaitUntil(release);
+    return release;
+  }
+
+private:
+  double speed_;
+  bool started_ = false;
+  uint64_t first_ts_recv_ = 0;
+  uint64_t start_ = 0;
+};
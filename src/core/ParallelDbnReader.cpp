@@ -0,0 +1,330 @@
+#include "ParallelDbnReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <zstd.h>
+
+namespace {
+
+constexpr size_t kPrefixSize = 8; // "DBN", version, u32 metadata length
+constexpr uint8_t kZstdMagic[4] = {0x28, 0xB5, 0x2F, 0xFD};
+// Output size per ring buffer when streaming a single frame
+constexpr size_t kStreamChunkSize = 4 << 20;
+
+struct DCtxDeleter {
+  void operator()(ZSTD_DCtx *dctx) const { ZSTD_freeDCtx(dctx); }
+};
+using DCtx = std::unique_ptr<ZSTD_DCtx, DCtxDeleter>;
+
+DCtx MakeDCtx() {
+  DCtx dctx{ZSTD_createDCtx()};
+  if (!dctx) {
+    throw std::runtime_error("Could not create zstd decompression context");
+  }
+  return dctx;
+}
+
+size_t CheckZstd(size_t result) {
+  if (ZSTD_isError(result)) {
+    throw std::runtime_error(std::string("zstd decompression failed: ") +
+                             ZSTD_getErrorName(result));
+  }
+  return result;
+}
+
+// Streams from in into buffer starting at *size until the buffer is full or
+// the input is finished. Returns the last ZSTD_decompressStream result,
+// which is 0 once a frame has been completely decoded and flushed.
+size_t StreamInto(ZSTD_DCtx *dctx, ZSTD_inBuffer &in,
+                  std::vector<std::byte> &buffer, size_t &size,
+                  size_t result) {
+  ZSTD_outBuffer out{buffer.data(), buffer.size(), size};
+  while (out.pos < out.size && !(in.pos == in.size && result == 0)) {
+    const size_t in_before = in.pos;
+    const size_t out_before = out.pos;
+    result = CheckZstd(ZSTD_decompressStream(dctx, &out, &in));
+    if (in.pos == in_before && out.pos == out_before) {
+      throw std::runtime_error("Compressed DBN file truncated");
+    }
+  }
+  size = out.pos;
+  return result;
+}
+
+} // namespace
+
+ParallelDbnReader::ParallelDbnReader(const std::string &path, size_t threads,
+                                     size_t ring_size, bool direct_io)
+    : ring_(ring_size) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Could not open DBN file: " + path);
+  }
+  uint8_t magic[4];
+  struct stat st;
+  if (::pread(fd, magic, sizeof(magic), 0) != sizeof(magic) ||
+      ::fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw std::runtime_error("DBN file truncated: " + path);
+  }
+  compressed_ = std::memcmp(magic, kZstdMagic, sizeof(kZstdMagic)) == 0;
+
+  if (compressed_) {
+    size_ = st.st_size;
+    void *mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+      throw std::runtime_error("Could not map DBN file: " + path);
+    }
+    ::madvise(mapping, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const std::byte *>(mapping);
+  } else {
+    ::close(fd);
+    uncompressed_ = std::make_unique<UringReader>(
+        path, UringReader::kDefaultBlockSize, ring_size, direct_io);
+  }
+
+  try {
+    if (compressed_) {
+      FindFrames();
+      if (frames_.size() > 1) {
+        size_t workers =
+            threads > 0 ? threads : std::thread::hardware_concurrency();
+        workers = std::clamp<size_t>(
+            workers, 1, std::min(frames_.size(), ring_.size()));
+        for (size_t i = 0; i < workers; ++i) {
+          workers_.emplace_back(&ParallelDbnReader::DecompressFrames, this);
+        }
+      } else {
+        workers_.emplace_back(&ParallelDbnReader::StreamFrame, this);
+      }
+    }
+
+    std::byte prefix[kPrefixSize];
+    ReadBytes(prefix, kPrefixSize);
+    if (std::memcmp(prefix, "DBN", 3) != 0) {
+      throw std::runtime_error("Not a DBN file: " + path);
+    }
+    uint32_t metadata_length;
+    std::memcpy(&metadata_length, prefix + 4, sizeof(metadata_length));
+    std::vector<std::byte> metadata(metadata_length);
+    ReadBytes(metadata.data(), metadata_length);
+  } catch (...) {
+    Shutdown();
+    throw;
+  }
+}
+
+ParallelDbnReader::~ParallelDbnReader() { Shutdown(); }
+
+void ParallelDbnReader::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  free_cv_.notify_all();
+  for (auto &worker : workers_) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+  if (data_ != nullptr) {
+    ::munmap(const_cast<std::byte *>(data_), size_);
+    data_ = nullptr;
+  }
+}
+
+void ParallelDbnReader::FindFrames() {
+  size_t offset = 0;
+  while (offset < size_) {
+    const size_t frame_size =
+        ZSTD_findFrameCompressedSize(data_ + offset, size_ - offset);
+    if (ZSTD_isError(frame_size)) {
+      throw std::runtime_error("Corrupt zstd frame in DBN file");
+    }
+    frames_.push_back(Frame{offset, frame_size});
+    offset += frame_size;
+  }
+}
+
+void ParallelDbnReader::DecompressFrames() {
+  try {
+    DCtx dctx = MakeDCtx();
+    for (uint64_t i = next_frame_++; i < frames_.size(); i = next_frame_++) {
+      Slot *slot = AcquireSlot(i);
+      if (slot == nullptr) {
+        return;
+      }
+
+      const Frame &frame = frames_[i];
+      const std::byte *src = data_ + frame.offset;
+      const unsigned long long content_size =
+          ZSTD_getFrameContentSize(src, frame.size);
+      if (content_size != ZSTD_CONTENTSIZE_UNKNOWN &&
+          content_size != ZSTD_CONTENTSIZE_ERROR) {
+        if (slot->buffer.size() < content_size) {
+          slot->buffer.resize(content_size);
+        }
+        slot->size = CheckZstd(ZSTD_decompressDCtx(
+            dctx.get(), slot->buffer.data(), content_size, src, frame.size));
+      } else {
+        // The frame header does not say how large it is, so grow as needed
+        ZSTD_DCtx_reset(dctx.get(), ZSTD_reset_session_only);
+        ZSTD_inBuffer in{src, frame.size, 0};
+        slot->size = 0;
+        size_t result = 1;
+        do {
+          if (slot->size == slot->buffer.size()) {
+            slot->buffer.resize(std::max(slot->buffer.size() * 2,
+                                         ZSTD_DStreamOutSize()));
+          }
+          result =
+              StreamInto(dctx.get(), in, slot->buffer, slot->size, result);
+        } while (!(in.pos == in.size && result == 0));
+      }
+      Publish(*slot, i + 1 == frames_.size());
+    }
+  } catch (...) {
+    Fail(std::current_exception());
+  }
+}
+
+void ParallelDbnReader::StreamFrame() {
+  try {
+    DCtx dctx = MakeDCtx();
+    ZSTD_inBuffer in{data_, size_, 0};
+    size_t result = 1;
+    for (uint64_t chunk = 0;; ++chunk) {
+      Slot *slot = AcquireSlot(chunk);
+      if (slot == nullptr) {
+        return;
+      }
+      if (slot->buffer.size() < kStreamChunkSize) {
+        slot->buffer.resize(kStreamChunkSize);
+      }
+      slot->size = 0;
+      result = StreamInto(dctx.get(), in, slot->buffer, slot->size, result);
+      const bool last = in.pos == in.size && result == 0;
+      Publish(*slot, last);
+      if (last) {
+        return;
+      }
+    }
+  } catch (...) {
+    Fail(std::current_exception());
+  }
+}
+
+ParallelDbnReader::Slot *ParallelDbnReader::AcquireSlot(uint64_t chunk) {
+  Slot &slot = ring_[chunk % ring_.size()];
+  std::unique_lock<std::mutex> lock(mutex_);
+  // The chunk must also be within a ring's length of the reader, or a worker
+  // far ahead could take the slot before the chunk it is meant for
+  free_cv_.wait(lock, [&] {
+    return stop_ ||
+           (slot.chunk == UINT64_MAX && chunk < chunk_ + ring_.size());
+  });
+  if (stop_) {
+    return nullptr;
+  }
+  slot.chunk = chunk;
+  slot.ready = false;
+  return &slot;
+}
+
+void ParallelDbnReader::Publish(Slot &slot, bool last) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    slot.ready = true;
+    slot.last = last;
+  }
+  ready_cv_.notify_all();
+}
+
+void ParallelDbnReader::Fail(std::exception_ptr error) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!error_) {
+      error_ = error;
+    }
+  }
+  ready_cv_.notify_all();
+}
+
+bool ParallelDbnReader::NextChunk() {
+  if (uncompressed_) {
+    const std::span<const std::byte> block = uncompressed_->Next();
+    cur_ = block.data();
+    end_ = cur_ + block.size();
+    return !block.empty();
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (current_ != nullptr) {
+    finished_ = current_->last;
+    current_->chunk = UINT64_MAX;
+    current_->ready = false;
+    current_ = nullptr;
+    ++chunk_;
+    free_cv_.notify_all();
+  }
+  if (finished_) {
+    return false;
+  }
+
+  Slot &slot = ring_[chunk_ % ring_.size()];
+  ready_cv_.wait(lock, [&] {
+    return error_ || (slot.chunk == chunk_ && slot.ready);
+  });
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+  current_ = &slot;
+  cur_ = slot.buffer.data();
+  end_ = cur_ + slot.size;
+  return true;
+}
+
+void ParallelDbnReader::ReadBytes(std::byte *dst, size_t size) {
+  while (size > 0) {
+    if (cur_ == end_ && !NextChunk()) {
+      throw std::runtime_error("DBN file truncated");
+    }
+    const size_t take = std::min<size_t>(size, end_ - cur_);
+    std::memcpy(dst, cur_, take);
+    dst += take;
+    cur_ += take;
+    size -= take;
+  }
+}
+
+const databento::Record *ParallelDbnReader::NextRecord() {
+  while (cur_ == end_) {
+    if (!NextChunk()) {
+      return nullptr;
+    }
+  }
+  const size_t length = static_cast<uint8_t>(*cur_) * 4;
+  if (length == 0) {
+    throw std::runtime_error("Corrupt DBN record");
+  }
+
+  const std::byte *record = cur_;
+  if (static_cast<size_t>(end_ - cur_) >= length &&
+      reinterpret_cast<uintptr_t>(record) % alignof(uint64_t) == 0) {
+    cur_ += length;
+  } else {
+    ReadBytes(record_, length);
+    record = record_;
+  }
+  record_view_ = databento::Record{const_cast<databento::RecordHeader *>(
+      reinterpret_cast<const databento::RecordHeader *>(record))};
+  return &record_view_;
+}
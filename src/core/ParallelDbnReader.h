@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "databento/record.hpp"
+
+#include "UringReader.h"
+
+// Reads DBN files, zstd-compressed or not, with decompression moved off the
+// thread that consumes the records.
+//
+// The compressed file is mmap'd and split into its zstd frames. When there
+// are several frames (e.g. files written by pzstd or by appending), worker
+// threads decompress them in parallel into a ring of buffers, which are
+// handed to the reader in file order. A single-frame file is streamed into
+// the ring by one background thread, so decompression still overlaps with
+// the book. Uncompressed files are read through a UringReader, which keeps
+// several reads in flight, optionally with O_DIRECT.
+//
+// Records are returned in place from the ring buffers; only a record that
+// straddles two buffers, or sits at an address unsuitable for Get<T>(), is
+// copied. Records are returned exactly as stored, without version upgrades.
+class ParallelDbnReader {
+public:
+  // threads = 0 uses one worker per hardware thread. direct_io only
+  // applies to uncompressed files.
+  explicit ParallelDbnReader(const std::string &path, size_t threads = 0,
+                             size_t ring_size = 8, bool direct_io = false);
+  ~ParallelDbnReader();
+
+  ParallelDbnReader(const ParallelDbnReader &) = delete;
+  ParallelDbnReader &operator=(const ParallelDbnReader &) = delete;
+
+  // Returns nullptr at the end of the file. The record stays valid until
+  // the next call. Rethrows any error hit by a worker thread.
+  const databento::Record *NextRecord();
+
+  bool compressed() const { return compressed_; }
+  size_t frame_count() const { return frames_.size(); }
+
+private:
+  struct Frame {
+    size_t offset;
+    size_t size;
+  };
+
+  struct Slot {
+    std::vector<std::byte> buffer;
+    size_t size = 0;
+    uint64_t chunk = UINT64_MAX; // Chunk held, or UINT64_MAX while free
+    bool ready = false;
+    bool last = false; // No chunks follow this one
+  };
+
+  // Stops and joins the workers and unmaps the file
+  void Shutdown();
+  void FindFrames();
+  void DecompressFrames();
+  void StreamFrame();
+
+  // Waits until the chunk's slot has been released by the reader. Returns
+  // nullptr when stopping.
+  Slot *AcquireSlot(uint64_t chunk);
+  void Publish(Slot &slot, bool last);
+  void Fail(std::exception_ptr error);
+
+  // Moves to the next chunk, releasing the current one
+  bool NextChunk();
+  void ReadBytes(std::byte *dst, size_t size);
+
+  const std::byte *data_ = nullptr; // Mapping of a compressed file
+  size_t size_ = 0;
+  bool compressed_ = false;
+  std::unique_ptr<UringReader> uncompressed_;
+  std::vector<Frame> frames_;
+
+  std::vector<Slot> ring_;
+  std::vector<std::thread> workers_;
+  std::atomic<uint64_t> next_frame_{0};
+  std::mutex mutex_;
+  std::condition_variable ready_cv_;
+  std::condition_variable free_cv_;
+  bool stop_ = false;
+  std::exception_ptr error_;
+
+  // Reader side
+  uint64_t chunk_ = 0; // Next chunk to consume
+  Slot *current_ = nullptr;
+  bool finished_ = false;
+  const std::byte *cur_ = nullptr;
+  const std::byte *end_ = nullptr;
+  alignas(8) std::byte record_[255 * 4];
+  databento::Record record_view_{nullptr};
+};
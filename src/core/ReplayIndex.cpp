@@ -0,0 +1,96 @@
+#include "ReplayIndex.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace replay_index {
+
+Builder::Builder(const std::string &path, uint64_t interval_messages,
+                 uint64_t interval_ns)
+    : file_{path, std::ios::binary | std::ios::trunc},
+      interval_messages_{interval_messages}, interval_ns_{interval_ns} {
+  if (!file_.is_open()) {
+    throw std::runtime_error("Could not open index for writing: " + path);
+  }
+}
+
+void Builder::Add(const checkpoint::Writer &checkpoint, uint64_t dbn_offset) {
+  const std::vector<char> &data = checkpoint.Data();
+  const checkpoint::Reader reader{data.data(), data.size()};
+
+  entries_.push_back(Entry{reader.header().position, dbn_offset, written_,
+                           data.size()});
+  last_ = reader.header().position;
+
+  file_.write(data.data(), data.size());
+  written_ += data.size();
+}
+
+void Builder::Finish() {
+  Trailer trailer;
+  trailer.table_offset = written_;
+  trailer.entry_count = entries_.size();
+  trailer.interval_messages = interval_messages_;
+  trailer.interval_ns = interval_ns_;
+  trailer.first_ts_event = first_ts_event_;
+
+  file_.write(reinterpret_cast<const char *>(entries_.data()),
+              entries_.size() * sizeof(Entry));
+  file_.write(reinterpret_cast<const char *>(&trailer), sizeof(trailer));
+  file_.close();
+  if (!file_) {
+    throw std::runtime_error("Failed writing index");
+  }
+}
+
+Index::Index(const std::string &path) : file_{path, std::ios::binary} {
+  if (!file_.is_open()) {
+    throw std::runtime_error("Could not open index: " + path);
+  }
+
+  file_.seekg(-static_cast<std::streamoff>(sizeof(Trailer)), std::ios::end);
+  file_.read(reinterpret_cast<char *>(&trailer_), sizeof(trailer_));
+  if (!file_ || trailer_.magic != kMagic) {
+    throw std::runtime_error("Not a replay index: " + path);
+  }
+  if (trailer_.version != kVersion) {
+    throw std::runtime_error("Unsupported replay index version: " + path);
+  }
+
+  entries_.resize(trailer_.entry_count);
+  file_.seekg(trailer_.table_offset);
+  file_.read(reinterpret_cast<char *>(entries_.data()),
+             entries_.size() * sizeof(Entry));
+  if (!file_ || entries_.empty()) {
+    throw std::runtime_error("Replay index truncated: " + path);
+  }
+}
+
+const Entry &Index::FindByTsEvent(uint64_t ts_event) const {
+  auto it = std::upper_bound(entries_.begin() + 1, entries_.end(), ts_event,
+                             [](uint64_t ts, const Entry &entry) {
+                               return ts < entry.position.ts_event;
+                             });
+  return *std::prev(it);
+}
+
+const Entry &Index::FindBySequence(uint32_t sequence) const {
+  auto it = std::upper_bound(entries_.begin() + 1, entries_.end(), sequence,
+                             [](uint32_t seq, const Entry &entry) {
+                               return seq < entry.position.sequence;
+                             });
+  return *std::prev(it);
+}
+
+std::vector<char> Index::ReadCheckpoint(const Entry &entry) {
+  std::vector<char> data(entry.checkpoint_size);
+  file_.clear();
+  file_.seekg(entry.checkpoint_offset);
+  file_.read(data.data(), data.size());
+  if (!file_) {
+    throw std::runtime_error("Replay index checkpoint truncated");
+  }
+  return data;
+}
+
+} // namespace replay_index
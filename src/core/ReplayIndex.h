@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Checkpoint.h"
+
+// Side-car index for a DBN file: book checkpoints taken at regular intervals
+// during one pass over the file, each paired with the byte offset of the
+// first record not yet applied. Restoring the nearest earlier checkpoint and
+// replaying from that offset reconstructs the book at any point in the file.
+//
+// Layout: checkpoint blobs back to back, then the Entry table, then Trailer.
+namespace replay_index {
+
+constexpr uint32_t kMagic = 0x58444952; // "RIDX"
+constexpr uint32_t kVersion = 2;
+
+#pragma pack(push, 1)
+struct Entry {
+  ReplayPosition position;
+  uint64_t dbn_offset;
+  uint64_t checkpoint_offset;
+  uint64_t checkpoint_size;
+};
+
+struct Trailer {
+  uint64_t table_offset;
+  uint64_t entry_count;
+  uint64_t interval_messages;
+  uint64_t interval_ns;
+  uint64_t first_ts_event; // Of the first message, 0 for an empty file
+  uint32_t version = kVersion;
+  uint32_t magic = kMagic;
+};
+#pragma pack(pop)
+
+inline std::string PathFor(const std::string &dbn_path) {
+  return dbn_path + ".idx";
+}
+
+class Builder {
+public:
+  // A checkpoint is taken whenever either interval has elapsed since the
+  // previous one; an interval of 0 disables that trigger.
+  Builder(const std::string &path, uint64_t interval_messages,
+          uint64_t interval_ns);
+
+  // Call after every message applied to the book. next_offset is the DBN
+  // offset of the record after that message.
+  template <typename Book>
+  void OnMessage(const Book &book, uint64_t next_offset) {
+    const ReplayPosition &position = book.Position();
+    if (position.message_count == 1) {
+      // The time interval runs from the first message, not from the epoch
+      // of the empty book's entry
+      first_ts_event_ = position.ts_event;
+      last_.ts_event = position.ts_event;
+    }
+    const bool messages_due =
+        interval_messages_ != 0 &&
+        position.message_count - last_.message_count >= interval_messages_;
+    // ts_event can step backwards between records, which must not wrap
+    const bool time_due = interval_ns_ != 0 &&
+                          position.ts_event >= last_.ts_event &&
+                          position.ts_event - last_.ts_event >= interval_ns_;
+    if (messages_due || time_due) {
+      Add(book.CreateCheckpoint(), next_offset);
+    }
+  }
+
+  // The first entry should be the empty book at the start of the records so
+  // that every point in the file has an entry to start from
+  void Add(const checkpoint::Writer &checkpoint, uint64_t dbn_offset);
+
+  // Writes the entry table and trailer
+  void Finish();
+
+  size_t size() const { return entries_.size(); }
+
+private:
+  std::ofstream file_;
+  uint64_t interval_messages_;
+  uint64_t interval_ns_;
+  uint64_t written_ = 0;
+  uint64_t first_ts_event_ = 0;
+  ReplayPosition last_;
+  std::vector<Entry> entries_;
+};
+
+class Index {
+public:
+  explicit Index(const std::string &path);
+
+  const std::vector<Entry> &entries() const { return entries_; }
+  const Trailer &trailer() const { return trailer_; }
+
+  // Latest entry taken at or before the given point, i.e. the best place to
+  // start replaying from to reach it
+  const Entry &FindByTsEvent(uint64_t ts_event) const;
+  const Entry &FindBySequence(uint32_t sequence) const;
+
+  std::vector<char> ReadCheckpoint(const Entry &entry);
+
+private:
+  std::ifstream file_;
+  Trailer trailer_;
+  std::vector<Entry> entries_;
+};
+
+} // namespace replay_index
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+// xoshiro256** seeded through SplitMix64. Unlike std::mt19937 with the
+// std:: distributions, whose output differs between standard libraries,
+// the same seed gives the same sequence on every platform, so generated
+// data can be compared bit for bit.
+class Rng {
+public:
+  // Streams with the same seed and different stream numbers are
+  // independent, e.g. one per instrument or per worker thread
+  explicit Rng(uint64_t seed, uint64_t stream = 0) {
+    uint64_t x = seed ^ (stream * 0xd1b54a32d192ed03ull);
+    for (uint64_t &word : s_) {
+      word = SplitMix64(x);
+    }
+  }
+
+  // Seed for an independent generator of its own, e.g. one per output file
+  static uint64_t Derive(uint64_t seed, uint64_t stream) {
+    return Rng{seed, stream}();
+  }
+
+  uint64_t operator()() {
+    const uint64_t result = Rotl(s_[1] * 5, 7) * 9;
+    const uint64_t t = s_[1] << 17;
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+    s_[2] ^= t;
+    s_[3] = Rotl(s_[3], 45);
+    return result;
+  }
+
+  // Uniform in [0, bound), by Lemire's multiply-shift. The bias is below
+  // bound / 2^64, which is negligible for the ranges used here.
+  uint64_t Below(uint64_t bound) {
+    return static_cast<uint64_t>(
+        (static_cast<unsigned __int128>((*this)()) * bound) >> 64);
+  }
+
+  // Uniform in [min, max]
+  int64_t Between(int64_t min, int64_t max) {
+    return min + static_cast<int64_t>(Below(max - min + 1));
+  }
+
+private:
+  static uint64_t Rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  static uint64_t SplitMix64(uint64_t &x) {
+    uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+
+  uint64_t s_[4];
+};
@@ -0,0 +1,103 @@
+#include "RunMode.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <alloca.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+std::runtime_error SystemError(const std::string &what, int error) {
+  return std::runtime_error(what + ": " + std::strerror(error));
+}
+
+size_t PageSize() { return static_cast<size_t>(::sysconf(_SC_PAGESIZE)); }
+
+} // namespace
+
+void run_mode::PinCurrentThread(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  const int error = ::pthread_setaffinity_np(::pthread_self(), sizeof(set),
+                                             &set);
+  if (error != 0) {
+    throw SystemError("Could not pin thread to CPU " + std::to_string(cpu),
+                      error);
+  }
+}
+
+void run_mode::LockMemory() {
+  // Keep freed memory in the heap rather than trimming it, and serve large
+  // allocations from the heap too instead of fresh mmaps
+  ::mallopt(M_TRIM_THRESHOLD, -1);
+  ::mallopt(M_MMAP_MAX, 0);
+  if (::mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    throw SystemError("mlockall failed", errno);
+  }
+}
+
+void run_mode::SetFifoPriority(int priority) {
+  sched_param param{};
+  param.sched_priority = priority;
+  const int error = ::pthread_setschedparam(
+      ::pthread_self(), priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param);
+  if (error != 0) {
+    throw SystemError("Could not set SCHED_FIFO priority " +
+                          std::to_string(priority),
+                      error);
+  }
+}
+
+void run_mode::PrefaultHeap(size_t bytes) {
+  auto *block = static_cast<volatile char *>(::malloc(bytes));
+  if (block == nullptr) {
+    throw std::runtime_error("Could not allocate heap to pre-fault");
+  }
+  for (size_t i = 0; i < bytes; i += PageSize()) {
+    block[i] = 0;
+  }
+  // With trimming disabled the pages stay with malloc for later allocations
+  ::free(const_cast<char *>(block));
+}
+
+void run_mode::PrefaultStack(size_t bytes) {
+  volatile char *stack = static_cast<volatile char *>(alloca(bytes));
+  for (size_t i = 0; i < bytes; i += PageSize()) {
+    stack[i] = 0;
+  }
+}
+
+void run_mode::EnterDecodePhase(const Config &config) {
+  static bool locked = false;
+  if (config.isolate && !locked) {
+    LockMemory();
+    PrefaultHeap();
+    locked = true;
+  }
+  if (config.fifo_priority > 0) {
+    SetFifoPriority(0);
+  }
+  if (config.decoder_cpu >= 0) {
+    PinCurrentThread(config.decoder_cpu);
+  }
+}
+
+void run_mode::EnterBookPhase(const Config &config) {
+  if (config.book_cpu >= 0) {
+    PinCurrentThread(config.book_cpu);
+  }
+  if (config.isolate) {
+    PrefaultStack();
+  }
+  if (config.fifo_priority > 0) {
+    SetFifoPriority(config.fifo_priority);
+  }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+
+// Process setup that keeps the OS out of measured latencies: pinning
+// threads to cores, locking and pre-faulting memory, and real-time
+// scheduling. A default Config changes nothing.
+//
+// A replay runs in two phases on the same thread. Loading and decoding
+// come first, then the timed loop over the book. Threads inherit the
+// affinity and scheduling policy of the thread that creates them, so the
+// decoder threads started while loading land on decoder_cpu without any
+// hooks in the readers.
+namespace run_mode {
+
+// Heap touched up front by --isolate, then kept by malloc for later
+// allocations
+constexpr size_t kPrefaultHeapBytes = 64 << 20;
+constexpr size_t kPrefaultStackBytes = 512 << 10;
+
+struct Config {
+  int book_cpu = -1;     // -1 leaves the thread unpinned
+  int decoder_cpu = -1;  // Applies to threads started while loading
+  bool isolate = false;  // mlockall and pre-fault the heap and stack
+  int fifo_priority = 0; // SCHED_FIFO priority of the book, 0 for none
+};
+
+// Throw std::runtime_error if the kernel refuses
+void PinCurrentThread(int cpu);
+// Also stops malloc from returning memory to the kernel, so that pages
+// faulted once stay resident
+void LockMemory();
+// A priority of 0 returns the thread to SCHED_OTHER
+void SetFifoPriority(int priority);
+
+void PrefaultHeap(size_t bytes = kPrefaultHeapBytes);
+void PrefaultStack(size_t bytes = kPrefaultStackBytes);
+
+// Call before loading a replay. Locks memory on the first call, pins to
+// decoder_cpu and drops back to SCHED_OTHER.
+void EnterDecodePhase(const Config &config);
+// Call after loading, before constructing the books, so their pools are
+// faulted in while resident memory is locked
+void EnterBookPhase(const Config &config);
+
+} // namespace run_mode
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Single-writer, multi-reader sequence lock. The writer never waits; a
+// reader copies the value and retries if a write overlapped its copy. The
+// value is copied as relaxed atomic words, so concurrent access is free of
+// data races.
+//
+// The sequence counter starts the slot on its own cache line so readers
+// polling it do not share a line with unrelated data.
+template <typename T> class alignas(64) SeqLock {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "SeqLock values are copied bytewise");
+
+public:
+  // Only ever called from the owning (writer) thread
+  void Store(const T &value) {
+    Word words[kWords] = {};
+    std::memcpy(words, &value, sizeof(T));
+
+    const uint64_t seq = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kWords; ++i) {
+      std::atomic_ref<Word>(words_[i]).store(words[i],
+                                             std::memory_order_relaxed);
+    }
+    sequence_.store(seq + 2, std::memory_order_release);
+  }
+
+  // Safe from any thread; spins only while a write is in progress
+  T Load() const {
+    T value;
+    while (!TryLoad(value)) {
+    }
+    return value;
+  }
+
+  // Fails, rather than retrying, if a write overlapped the copy
+  bool TryLoad(T &value) const {
+    const uint64_t before = sequence_.load(std::memory_order_acquire);
+    if (before & 1) {
+      return false;
+    }
+
+    Word words[kWords];
+    for (size_t i = 0; i < kWords; ++i) {
+      words[i] = std::atomic_ref<Word>(const_cast<Word &>(words_[i]))
+                     .load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence_.load(std::memory_order_relaxed) != before) {
+      return false;
+    }
+
+    std::memcpy(&value, words, sizeof(T));
+    return true;
+  }
+
+  // Number of completed writes
+  uint64_t Version() const {
+    return sequence_.load(std::memory_order_acquire) / 2;
+  }
+
+private:
+  using Word = uint64_t;
+  static constexpr size_t kWords =
+      (sizeof(T) + sizeof(Word) - 1) / sizeof(Word);
+
+  std::atomic<uint64_t> sequence_{0};
+  alignas(Word) Word words_[kWords] = {};
+};
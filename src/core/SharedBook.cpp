@@ -0,0 +1,160 @@
+#include "SharedBook.h"
+
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace shared_book {
+
+namespace {
+
+// shm_open wants a single leading slash
+std::string ShmName(const std::string &name) {
+  return name.front() == '/' ? name : "/" + name;
+}
+
+} // namespace
+
+Publisher::Publisher(const std::string &name, uint32_t capacity)
+    : size_{sizeof(SegmentHeader) + capacity * sizeof(Slot)} {
+  // Start from a fresh object rather than truncating one that readers may
+  // still have mapped, which would fault them with SIGBUS
+  ::shm_unlink(ShmName(name).c_str());
+  const int fd =
+      ::shm_open(ShmName(name).c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Could not create shared memory: " + name);
+  }
+  if (::ftruncate(fd, size_) != 0) {
+    ::close(fd);
+    throw std::runtime_error("Could not size shared memory: " + name);
+  }
+  mapping_ = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapping_ == MAP_FAILED) {
+    throw std::runtime_error("Could not map shared memory: " + name);
+  }
+
+  header_ = new (mapping_) SegmentHeader{};
+  header_->version = kVersion;
+  header_->depth = kPublishedDepth;
+  header_->capacity = capacity;
+  slots_ = reinterpret_cast<Slot *>(static_cast<char *>(mapping_) +
+                                    sizeof(SegmentHeader));
+  for (uint32_t i = 0; i < capacity; ++i) {
+    new (&slots_[i]) Slot{};
+  }
+  header_->magic.store(kMagic, std::memory_order_release);
+}
+
+Publisher::~Publisher() {
+  if (mapping_ != nullptr) {
+    ::munmap(mapping_, size_);
+  }
+}
+
+void Publisher::Unlink(const std::string &name) {
+  ::shm_unlink(ShmName(name).c_str());
+}
+
+void Publisher::Publish(uint32_t instrument_id, const TopOfBook &top) {
+  SlotFor(instrument_id).top.Store(top);
+}
+
+Slot &Publisher::SlotFor(uint32_t instrument_id) {
+  auto it = slot_by_instrument_.find(instrument_id);
+  if (it != slot_by_instrument_.end()) {
+    return *it->second;
+  }
+
+  const uint32_t index =
+      header_->instrument_count.load(std::memory_order_relaxed);
+  if (index == header_->capacity) {
+    throw std::runtime_error("Shared book segment is full");
+  }
+  Slot *slot = &slots_[index];
+  slot->instrument_id = instrument_id;
+  // Readers only look at slots below instrument_count
+  header_->instrument_count.store(index + 1, std::memory_order_release);
+  slot_by_instrument_.emplace(instrument_id, slot);
+  return *slot;
+}
+
+Reader::Reader(const std::string &name) {
+  const int fd = ::shm_open(ShmName(name).c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    throw std::runtime_error("Could not open shared memory: " + name);
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(SegmentHeader)) {
+    ::close(fd);
+    throw std::runtime_error("Shared book segment not ready: " + name);
+  }
+  size_ = st.st_size;
+  mapping_ = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapping_ == MAP_FAILED) {
+    throw std::runtime_error("Could not map shared memory: " + name);
+  }
+
+  header_ = static_cast<const SegmentHeader *>(mapping_);
+  slots_ = reinterpret_cast<const Slot *>(static_cast<const char *>(mapping_) +
+                                          sizeof(SegmentHeader));
+  if (header_->magic.load(std::memory_order_acquire) != kMagic) {
+    throw std::runtime_error("Not a shared book segment: " + name);
+  }
+  if (header_->version != kVersion || header_->depth != kPublishedDepth) {
+    throw std::runtime_error("Incompatible shared book segment: " + name);
+  }
+  if (size_ < sizeof(SegmentHeader) + header_->capacity * sizeof(Slot)) {
+    throw std::runtime_error("Shared book segment truncated: " + name);
+  }
+}
+
+Reader::~Reader() {
+  if (mapping_ != nullptr) {
+    ::munmap(const_cast<void *>(mapping_), size_);
+  }
+}
+
+std::vector<uint32_t> Reader::Instruments() const {
+  const uint32_t count =
+      header_->instrument_count.load(std::memory_order_acquire);
+  std::vector<uint32_t> instruments;
+  instruments.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    instruments.push_back(slots_[i].instrument_id);
+  }
+  return instruments;
+}
+
+bool Reader::Read(uint32_t instrument_id, TopOfBook &top) const {
+  const Slot *slot = Find(instrument_id);
+  if (slot == nullptr || slot->top.Version() == 0) {
+    return false;
+  }
+  top = slot->top.Load();
+  return true;
+}
+
+uint64_t Reader::Version(uint32_t instrument_id) const {
+  const Slot *slot = Find(instrument_id);
+  return slot == nullptr ? 0 : slot->top.Version();
+}
+
+const Slot *Reader::Find(uint32_t instrument_id) const {
+  const uint32_t count =
+      header_->instrument_count.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < count; ++i) {
+    if (slots_[i].instrument_id == instrument_id) {
+      return &slots_[i];
+    }
+  }
+  return nullptr;
+}
+
+} // namespace shared_book
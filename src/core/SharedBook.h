@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "SeqLock.h"
+#include "TopOfBook.h"
+
+// Publication of per-instrument TopOfBook snapshots through a POSIX
+// shared-memory segment, so other processes can mmap it and poll for
+// changes without going through files or sockets.
+//
+// Layout: SegmentHeader, then `capacity` Slots. Each slot is claimed by one
+// instrument and holds the same SeqLock<TopOfBook> the books publish into,
+// which is address free and so safe to share between processes. A reader
+// detects changes by polling a slot's Version().
+namespace shared_book {
+
+constexpr uint32_t kMagic = 0x4b424853; // "SHBK"
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kDefaultCapacity = 1024;
+
+struct alignas(64) SegmentHeader {
+  std::atomic<uint32_t> magic; // Written last, once the segment is ready
+  uint32_t version;
+  uint32_t depth;
+  uint32_t capacity;
+  std::atomic<uint32_t> instrument_count;
+};
+
+struct alignas(64) Slot {
+  uint32_t instrument_id;
+  SeqLock<TopOfBook> top;
+};
+
+// Creates the segment, replacing any earlier one of the same name, and is its
+// only writer. Readers attached to a replaced segment keep their old mapping
+// and must reopen by name to follow the new publisher.
+class Publisher {
+public:
+  explicit Publisher(const std::string &name,
+                     uint32_t capacity = kDefaultCapacity);
+  ~Publisher();
+
+  Publisher(const Publisher &) = delete;
+  Publisher &operator=(const Publisher &) = delete;
+
+  void Publish(uint32_t instrument_id, const TopOfBook &top);
+
+  // Removes the segment name; processes that have it mapped keep reading
+  static void Unlink(const std::string &name);
+
+private:
+  Slot &SlotFor(uint32_t instrument_id);
+
+  void *mapping_ = nullptr;
+  size_t size_ = 0;
+  SegmentHeader *header_ = nullptr;
+  Slot *slots_ = nullptr;
+  std::unordered_map<uint32_t, Slot *> slot_by_instrument_;
+};
+
+// Read-only view of a segment, usable from any number of processes
+class Reader {
+public:
+  explicit Reader(const std::string &name);
+  ~Reader();
+
+  Reader(const Reader &) = delete;
+  Reader &operator=(const Reader &) = delete;
+
+  std::vector<uint32_t> Instruments() const;
+
+  // False if nothing has been published for the instrument yet
+  bool Read(uint32_t instrument_id, TopOfBook &top) const;
+
+  // Number of snapshots published for the instrument; poll this to detect
+  // changes cheaply
+  uint64_t Version(uint32_t instrument_id) const;
+
+private:
+  const Slot *Find(uint32_t instrument_id) const;
+
+  const void *mapping_ = nullptr;
+  size_t size_ = 0;
+  const SegmentHeader *header_ = nullptr;
+  const Slot *slots_ = nullptr;
+};
+
+} // namespace shared_book
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "databento/record.hpp"
+
+#include "TopOfBook.h"
+
+// Decides after which messages a full book snapshot is written, so that
+// output grows with the number of samples rather than the number of
+// messages. The book itself still applies every message.
+class SnapshotSampler {
+public:
+  // A snapshot is taken when any enabled trigger fires; with none enabled,
+  // after every message
+  struct Config {
+    uint64_t every_messages = 0; // Every Nth message
+    uint64_t every_nanos = 0;    // First message in each ts_event interval
+    uint32_t top_levels = 0;     // Top levels per side differ from the last
+                                 // snapshot
+  };
+
+  explicit SnapshotSampler(const Config &config) : config_{config} {
+    if (config_.top_levels > kPublishedDepth) {
+      throw std::invalid_argument("Sampling watches at most " +
+                                  std::to_string(kPublishedDepth) +
+                                  " levels");
+    }
+  }
+
+  bool Enabled() const {
+    return config_.every_messages != 0 || config_.every_nanos != 0 ||
+           config_.top_levels != 0;
+  }
+
+  // Call after the book has applied msg. The top of book is only loaded
+  // when the top levels are watched, from a book built with
+  // BookFeatures::PublishTop.
+  template <typename Book>
+  bool Sample(const databento::MboMsg &msg, const Book &book) {
+    bool sample = !Enabled();
+    if (config_.every_messages != 0 &&
+        ++messages_ % config_.every_messages == 0) {
+      sample = true;
+    }
+    const uint64_t ts_event = msg.hd.ts_event.time_since_epoch().count();
+    if (config_.every_nanos != 0 && ts_event >= next_ts_) {
+      next_ts_ = (ts_event / config_.every_nanos + 1) * config_.every_nanos;
+      sample = true;
+    }
+    if (config_.top_levels != 0) {
+      const TopOfBook top = book.Published().Load();
+      if (sample || TopChanged(top)) {
+        last_ = top;
+        sample = true;
+      }
+    }
+    return sample;
+  }
+
+private:
+  bool TopChanged(const TopOfBook &top) const {
+    for (uint32_t i = 0; i < config_.top_levels; ++i) {
+      if (!Same(top.bids[i], last_.bids[i]) ||
+          !Same(top.asks[i], last_.asks[i])) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static bool Same(const PublishedLevel &a, const PublishedLevel &b) {
+    return a.price == b.price && a.quantity == b.quantity &&
+           a.order_count == b.order_count;
+  }
+
+  Config config_;
+  uint64_t messages_ = 0;
+  uint64_t next_ts_ = 0;
+  TopOfBook last_{};
+};
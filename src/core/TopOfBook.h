@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Checkpoint.h"
+#include "Order.h"
+
+constexpr size_t kPublishedDepth = 10;
+
+struct PublishedLevel {
+  Price price;
+  uint64_t quantity;
+  uint32_t order_count;
+};
+
+// Snapshot of the best kPublishedDepth levels per side, published by the
+// books after every message. Unused levels are zeroed, and best_bid/best_ask
+// are 0 for an empty side, as with GetBestBid()/GetBestAsk().
+struct TopOfBook {
+  ReplayPosition position;
+  Price best_bid;
+  Price best_ask;
+  uint32_t bid_depth;
+  uint32_t ask_depth;
+  PublishedLevel bids[kPublishedDepth];
+  PublishedLevel asks[kPublishedDepth];
+};
+
+namespace book_utils {
+
+// Copies the first kPublishedDepth levels of a price-ordered container of
+// OrderList pointers
+template <typename Book>
+uint32_t FillLevels(const Book &book,
+                    PublishedLevel (&levels)[kPublishedDepth]) {
+  uint32_t depth = 0;
+  for (auto it = book.begin(); it != book.end() && depth < kPublishedDepth;
+       ++it, ++depth) {
+    levels[depth] = PublishedLevel{it->first, it->second->total_quantity,
+                                   it->second->order_count};
+  }
+  for (uint32_t i = depth; i < kPublishedDepth; ++i) {
+    levels[i] = PublishedLevel{};
+  }
+  return depth;
+}
+
+template <typename BidBook, typename AskBook>
+TopOfBook MakeTopOfBook(const BidBook &bids, const AskBook &asks,
+                        const ReplayPosition &position) {
+  TopOfBook top;
+  top.position = position;
+  top.bid_depth = FillLevels(bids, top.bids);
+  top.ask_depth = FillLevels(asks, top.asks);
+  top.best_bid = top.bids[0].price;
+  top.best_ask = top.asks[0].price;
+  return top;
+}
+
+} // namespace book_utils
@@ -0,0 +1,305 @@
+#include "UringReader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+// O_DIRECT needs buffers, offsets and lengths aligned to the logical block
+// size; a page covers every common device
+constexpr size_t kAlignment = 4096;
+
+int io_uring_setup(unsigned entries, io_uring_params *params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete,
+                   unsigned flags) {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                                    min_complete, flags, nullptr, 0));
+}
+
+int io_uring_register(int ring_fd, unsigned opcode, const void *arg,
+                      unsigned nr_args) {
+  return static_cast<int>(
+      ::syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args));
+}
+
+unsigned LoadAcquire(const unsigned *p) {
+  return std::atomic_ref<const unsigned>(*p).load(std::memory_order_acquire);
+}
+
+void StoreRelease(unsigned *p, unsigned value) {
+  std::atomic_ref<unsigned>(*p).store(value, std::memory_order_release);
+}
+
+} // namespace
+
+UringReader::UringReader(const std::string &path, size_t block_size,
+                         size_t queue_depth, bool direct_io)
+    : block_size_{(block_size + kAlignment - 1) / kAlignment * kAlignment},
+      direct_io_{direct_io}, buffers_(queue_depth) {
+  if (direct_io_) {
+    fd_ = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+    // Some filesystems, e.g. tmpfs, do not support O_DIRECT
+    if (fd_ < 0 && errno == EINVAL) {
+      direct_io_ = false;
+    }
+  }
+  if (fd_ < 0) {
+    fd_ = ::open(path.c_str(), O_RDONLY);
+  }
+  if (fd_ < 0) {
+    throw std::runtime_error("Could not open file: " + path);
+  }
+  struct stat st;
+  if (::fstat(fd_, &st) != 0) {
+    ::close(fd_);
+    throw std::runtime_error("Could not stat file: " + path);
+  }
+  file_size_ = st.st_size;
+
+  try {
+    for (Buffer &buffer : buffers_) {
+      buffer.data = static_cast<std::byte *>(
+          std::aligned_alloc(kAlignment, block_size_));
+      if (buffer.data == nullptr) {
+        throw std::bad_alloc();
+      }
+    }
+    SetupRing();
+
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+      Submit(i, next_submit_++);
+    }
+    Flush();
+  } catch (...) {
+    Close();
+    throw;
+  }
+}
+
+UringReader::~UringReader() { Close(); }
+
+void UringReader::Close() {
+  // The kernel may still be writing into the buffers
+  if (ring_fd_ >= 0) {
+    try {
+      Flush();
+      while (in_flight_ > 0) {
+        Reap(true);
+      }
+    } catch (const std::exception &) {
+      // Nothing more can be reaped; closing the ring cancels the rest
+    }
+    ::munmap(sqes_, sqes_size_);
+    if (cq_ring_ != sq_ring_) {
+      ::munmap(cq_ring_, cq_ring_size_);
+    }
+    ::munmap(sq_ring_, sq_ring_size_);
+    ::close(ring_fd_);
+    ring_fd_ = -1;
+  }
+  for (Buffer &buffer : buffers_) {
+    std::free(buffer.data);
+    buffer.data = nullptr;
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+void UringReader::SetupRing() {
+  io_uring_params params{};
+  const int ring_fd = io_uring_setup(buffers_.size(), &params);
+  if (ring_fd < 0) {
+    return;
+  }
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+  sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED) {
+    ::close(ring_fd);
+    return;
+  }
+  cq_ring_ = single_mmap
+                 ? sq_ring_
+                 : ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_fd,
+                          IORING_OFF_CQ_RING);
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  void *sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+  if (cq_ring_ == MAP_FAILED || sqes == MAP_FAILED) {
+    if (sqes != MAP_FAILED) {
+      ::munmap(sqes, sqes_size_);
+    }
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+      ::munmap(cq_ring_, cq_ring_size_);
+    }
+    ::munmap(sq_ring_, sq_ring_size_);
+    ::close(ring_fd);
+    return;
+  }
+  sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+  auto *sq = static_cast<char *>(sq_ring_);
+  sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  auto *cq = static_cast<char *>(cq_ring_);
+  cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+  ring_fd_ = ring_fd;
+
+  // Registered buffers skip pinning the pages on every read. Registration
+  // counts against RLIMIT_MEMLOCK, so plain reads are the fallback.
+  std::vector<iovec> iovecs;
+  for (const Buffer &buffer : buffers_) {
+    iovecs.push_back({buffer.data, block_size_});
+  }
+  fixed_buffers_ = io_uring_register(ring_fd_, IORING_REGISTER_BUFFERS,
+                                     iovecs.data(), iovecs.size()) == 0;
+}
+
+void UringReader::Submit(size_t buffer_index, uint64_t block) {
+  Buffer &buffer = buffers_[buffer_index];
+  buffer.offset = block * block_size_;
+  buffer.done = false;
+  if (buffer.offset >= file_size_ || ring_fd_ < 0) {
+    return;
+  }
+
+  const unsigned tail = *sq_tail_;
+  const unsigned index = tail & *sq_mask_;
+  io_uring_sqe &sqe = sqes_[index];
+  std::memset(&sqe, 0, sizeof(sqe));
+  sqe.opcode = fixed_buffers_ ? IORING_OP_READ_FIXED : IORING_OP_READ;
+  sqe.fd = fd_;
+  sqe.addr = reinterpret_cast<uint64_t>(buffer.data);
+  sqe.len = block_size_;
+  sqe.off = buffer.offset;
+  sqe.user_data = buffer_index;
+  if (fixed_buffers_) {
+    sqe.buf_index = buffer_index;
+  }
+  sq_array_[index] = index;
+  StoreRelease(sq_tail_, tail + 1);
+  ++pending_submissions_;
+  ++in_flight_;
+}
+
+void UringReader::Flush() {
+  while (pending_submissions_ > 0) {
+    const int submitted = io_uring_enter(ring_fd_, pending_submissions_, 0, 0);
+    if (submitted < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error(std::string("io_uring submit failed: ") +
+                               std::strerror(errno));
+    }
+    pending_submissions_ -= submitted;
+  }
+}
+
+void UringReader::Reap(bool wait) {
+  unsigned head = *cq_head_;
+  unsigned tail = LoadAcquire(cq_tail_);
+  while (head == tail && wait) {
+    if (io_uring_enter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+        errno != EINTR) {
+      throw std::runtime_error(std::string("io_uring wait failed: ") +
+                               std::strerror(errno));
+    }
+    tail = LoadAcquire(cq_tail_);
+  }
+  for (; head != tail; ++head) {
+    const io_uring_cqe &cqe = cqes_[head & *cq_mask_];
+    Buffer &buffer = buffers_[cqe.user_data];
+    buffer.result = cqe.res;
+    buffer.done = true;
+    --in_flight_;
+  }
+  StoreRelease(cq_head_, head);
+}
+
+std::span<const std::byte> UringReader::Next() {
+  if (outstanding_ != SIZE_MAX) {
+    Submit(outstanding_, next_submit_++);
+    outstanding_ = SIZE_MAX;
+    Flush();
+  }
+
+  const uint64_t offset = next_block_ * block_size_;
+  if (offset >= file_size_) {
+    return {};
+  }
+  const size_t index = next_block_ % buffers_.size();
+  Buffer &buffer = buffers_[index];
+
+  if (ring_fd_ >= 0) {
+    while (!buffer.done) {
+      Reap(true);
+    }
+  } else {
+    buffer.result = ::pread(fd_, buffer.data, block_size_, offset);
+    if (buffer.result < 0) {
+      buffer.result = -errno;
+    }
+  }
+  if (buffer.result < 0) {
+    throw std::runtime_error(std::string("Read failed: ") +
+                             std::strerror(-buffer.result));
+  }
+
+  // Regular files only come up short at the end, but finish the block
+  // synchronously if the kernel stopped early anyway. O_DIRECT needs the
+  // offset and length aligned too, so the read resumes from the last
+  // aligned boundary and asks for whole aligned blocks, which simply come
+  // up short at the end of the file.
+  const size_t expected = std::min<uint64_t>(block_size_, file_size_ - offset);
+  size_t size = buffer.result;
+  while (size < expected) {
+    const size_t resume = direct_io_ ? size / kAlignment * kAlignment : size;
+    const size_t length =
+        direct_io_
+            ? (expected - resume + kAlignment - 1) / kAlignment * kAlignment
+            : expected - resume;
+    const ssize_t n =
+        ::pread(fd_, buffer.data + resume, length, offset + resume);
+    if (n < 0) {
+      throw std::runtime_error(std::string("Read failed: ") +
+                               std::strerror(errno));
+    }
+    if (resume + n <= size) {
+      throw std::runtime_error("Unexpected end of file");
+    }
+    size = resume + n;
+  }
+
+  ++next_block_;
+  outstanding_ = index;
+  return {buffer.data, std::min(size, expected)};
+}
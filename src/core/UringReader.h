@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+// Sequential file reader that keeps several large reads in flight through
+// io_uring, so the thread consuming the blocks is not left waiting on the
+// disk for every read.
+//
+// The buffers are page aligned and registered with the ring, and reads can
+// optionally bypass the page cache with O_DIRECT. Blocks are handed out in
+// file order as their reads complete. Talks to the kernel through the raw
+// syscalls, and falls back to blocking pread() where io_uring is
+// unavailable (old kernels, seccomp).
+class UringReader {
+public:
+  static constexpr size_t kDefaultBlockSize = 1 << 20;
+  static constexpr size_t kDefaultQueueDepth = 8;
+
+  explicit UringReader(const std::string &path,
+                       size_t block_size = kDefaultBlockSize,
+                       size_t queue_depth = kDefaultQueueDepth,
+                       bool direct_io = false);
+  ~UringReader();
+
+  UringReader(const UringReader &) = delete;
+  UringReader &operator=(const UringReader &) = delete;
+
+  // The next block of the file, or an empty span at the end. The block
+  // stays valid until the next call.
+  std::span<const std::byte> Next();
+
+  bool uses_io_uring() const { return ring_fd_ >= 0; }
+  bool direct_io() const { return direct_io_; }
+
+private:
+  struct Buffer {
+    std::byte *data = nullptr;
+    uint64_t offset = 0; // File offset of the block being read into it
+    int64_t result = 0;  // Bytes read, or -errno
+    bool done = false;
+  };
+
+  // Leaves ring_fd_ at -1 if io_uring is unavailable
+  void SetupRing();
+  // Waits for reads still in flight, then releases everything
+  void Close();
+  void Submit(size_t buffer_index, uint64_t offset);
+  void Flush();
+  void Reap(bool wait);
+
+  int fd_ = -1;
+  uint64_t file_size_ = 0;
+  size_t block_size_;
+  bool direct_io_ = false;
+  std::vector<Buffer> buffers_;
+
+  // Next block to submit and next block to hand out
+  uint64_t next_submit_ = 0;
+  uint64_t next_block_ = 0;
+  // Buffer handed out by the last call, resubmitted on the next one
+  size_t outstanding_ = SIZE_MAX;
+
+  int ring_fd_ = -1;
+  bool fixed_buffers_ = false;
+  unsigned pending_submissions_ = 0; // Queued but not yet entered
+  unsigned in_flight_ = 0;           // Submitted but not yet completed
+  void *sq_ring_ = nullptr;
+  size_t sq_ring_size_ = 0;
+  void *cq_ring_ = nullptr;
+  size_t cq_ring_size_ = 0;
+  io_uring_sqe *sqes_ = nullptr;
+  size_t sqes_size_ = 0;
+  unsigned *sq_head_ = nullptr;
+  unsigned *sq_tail_ = nullptr;
+  unsigned *sq_mask_ = nullptr;
+  unsigned *sq_array_ = nullptr;
+  unsigned *cq_head_ = nullptr;
+  unsigned *cq_tail_ = nullptr;
+  unsigned *cq_mask_ = nullptr;
+  io_uring_cqe *cqes_ = nullptr;
+};
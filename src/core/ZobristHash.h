@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Order.h"
+
+// Zobrist-style 64-bit hash of a book's full state, kept up to date in
+// O(1) per mutation so that two implementations can be compared after
+// every message instead of by diffing their output.
+//
+// The hash is the XOR of one term per resting order, mixing its id, side,
+// price, quantity and the id of the order ahead of it in the queue. The
+// predecessor pins down queue position without renumbering the orders
+// behind a removed one, and makes the hash depend only on the state: a
+// book loaded from a checkpoint hashes the same as the book that wrote it.
+class ZobristHash {
+public:
+  uint64_t value() const { return hash_; }
+
+  void Reset() { hash_ = 0; }
+
+  // After order has been linked in at the tail of its level
+  void OnAppend(const Order *order) {
+    hash_ ^= Term(*order, order->quantity, PrevId(order));
+  }
+
+  // Before order is unlinked from its level. The order behind it moves up
+  // behind order's own predecessor.
+  void OnRemove(const Order *order) {
+    const OrderId prev = PrevId(order);
+    hash_ ^= Term(*order, order->quantity, prev);
+    if (const Order *next = order->next) {
+      hash_ ^= Term(*next, next->quantity, order->order_id) ^
+               Term(*next, next->quantity, prev);
+    }
+  }
+
+  // Before order's quantity changes in place
+  void OnQuantityChange(const Order *order, Quantity quantity) {
+    const OrderId prev = PrevId(order);
+    hash_ ^= Term(*order, order->quantity, prev) ^
+             Term(*order, quantity, prev);
+  }
+
+private:
+  static OrderId PrevId(const Order *order) {
+    return order->prev != nullptr ? order->prev->order_id : 0;
+  }
+
+  // SplitMix64 finalizer
+  static uint64_t Mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+
+  static uint64_t Term(const Order &order, Quantity quantity, OrderId prev) {
+    uint64_t h = Mix(order.order_id + 0x9e3779b97f4a7c15ull);
+    h = Mix(h ^ static_cast<uint64_t>(order.price));
+    h = Mix(h ^ (uint64_t{quantity} << 8 | static_cast<uint8_t>(order.side)));
+    return Mix(h ^ prev);
+  }
+
+  uint64_t hash_ = 0;
+};
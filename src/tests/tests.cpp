@@ -1,9 +1,45 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "databento/dbn_encoder.hpp"
+#include "databento/file_stream.hpp"
+
+#include "Analytics.h"
+#include "Bars.h"
+#include "CustomAllocationMapOrderBook.h"
+#include "DatagramFeed.h"
+#include "DbnMergeReader.h"
+#include "DepthLadder.h"
 #include "FlatMapOrderBook.h"
+#include "Heatmap.h"
+#include "MarketGenerator.h"
+#include "MatchingEngine.h"
+#include "MessageCache.h"
 #include "OrderBook.h"
+#include "ParallelDbnReader.h"
+#include "ReplayIndex.h"
+#include "RunMode.h"
+#include "SeqLock.h"
+#include "SharedBook.h"
+#include "SnapshotSampler.h"
+#include "UringReader.h"
 #include "gtest/gtest.h"
 
-// using OrderBook_t = OrderBook;
-using OrderBook_t = FlatMapOrderBook;
+#include <zstd.h>
+
+template <typename Book> class OrderBookTest : public ::testing::Test {};
+
+using OrderBookTypes = ::testing::Types<OrderBook, FlatMapOrderBook,
+                                        CustomAllocationMapOrderBook>;
+TYPED_TEST_SUITE(OrderBookTest, OrderBookTypes);
 
 databento::MboMsg CreateMboMsg(OrderId order_id, Price price, Quantity quantity,
                                char side, char action) {
@@ -17,24 +53,36 @@ databento::MboMsg CreateMboMsg(OrderId order_id, Price price, Quantity quantity,
   return msg;
 }
 
-TEST(OrderBookTest, AddSingleBid) {
-  OrderBook_t book;
+TYPED_TEST(OrderBookTest, AddSingleBid) {
+  TypeParam book;
   auto msg = CreateMboMsg(1, 10000, 10, 'B', 'A');
   book.ProcessMboMsg(msg);
   EXPECT_EQ(book.GetBestBid(), 10000);
   EXPECT_EQ(book.GetBestAsk(), 0);
 }
 
-TEST(OrderBookTest, AddSingleAsk) {
-  OrderBook_t book;
+TYPED_TEST(OrderBookTest, AddSingleAsk) {
+  TypeParam book;
   auto msg = CreateMboMsg(1, 10100, 10, 'A', 'A');
   book.ProcessMboMsg(msg);
   EXPECT_EQ(book.GetBestAsk(), 10100);
   EXPECT_EQ(book.GetBestBid(), 0);
 }
 
-TEST(OrderBookTest, AddAndCancelBid) {
-  OrderBook_t book;
+TYPED_TEST(OrderBookTest, GrowsPastItsPoolSize) {
+  TypeParam book{MatchMode::CrossLocally, 2};
+  for (OrderId id = 1; id <= 40; ++id) {
+    book.ProcessMboMsg(CreateMboMsg(id, 10000 - id, 10, 'B', 'A'));
+  }
+  EXPECT_EQ(book.GetBestBid(), 9999);
+  for (OrderId id = 1; id <= 39; ++id) {
+    book.ProcessMboMsg(CreateMboMsg(id, 10000 - id, 10, 'B', 'C'));
+  }
+  EXPECT_EQ(book.GetBestBid(), 9960);
+}
+
+TYPED_TEST(OrderBookTest, AddAndCancelBid) {
+  TypeParam book;
   auto add_msg = CreateMboMsg(1, 10000, 10, 'B', 'A');
   book.ProcessMboMsg(add_msg);
   EXPECT_EQ(book.GetBestBid(), 10000);
@@ -44,8 +92,8 @@ TEST(OrderBookTest, AddAndCancelBid) {
   EXPECT_EQ(book.GetBestBid(), 0);
 }
 
-TEST(OrderBookTest, SimpleCross) {
-  OrderBook_t book;
+TYPED_TEST(OrderBookTest, SimpleCross) {
+  TypeParam book;
   auto ask_msg = CreateMboMsg(1, 10100, 10, 'A', 'A');
   book.ProcessMboMsg(ask_msg);
   EXPECT_EQ(book.GetBestAsk(), 10100);
@@ -61,8 +109,8 @@ TEST(OrderBookTest, SimpleCross) {
   EXPECT_EQ(book.GetBestAsk(), 10100);
 }
 
-TEST(OrderBookTest, FullCross) {
-  OrderBook_t book;
+TYPED_TEST(OrderBookTest, FullCross) {
+  TypeParam book;
   auto ask_msg = CreateMboMsg(1, 10100, 10, 'A', 'A');
   book.ProcessMboMsg(ask_msg);
 
@@ -75,8 +123,22 @@ TEST(OrderBookTest, FullCross) {
   EXPECT_EQ(book.GetBestAsk(), 0);
 }
 
-TEST(OrderBookTest, AddMultipleAndCancel) {
-  OrderBook_t book;
+TYPED_TEST(OrderBookTest, TrustFeedLeavesCrossesToTheFeed) {
+  TypeParam book{MatchMode::TrustFeed};
+  book.ProcessMboMsg(CreateMboMsg(1, 10100, 10, 'A', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(2, 10100, 10, 'B', 'A'));
+  EXPECT_EQ(book.GetBestBid(), 10100);
+  EXPECT_EQ(book.GetBestAsk(), 10100);
+
+  // The exchange reports the fill and removes both orders itself
+  book.ProcessMboMsg(CreateMboMsg(1, 10100, 10, 'A', 'F'));
+  book.ProcessMboMsg(CreateMboMsg(2, 10100, 10, 'B', 'F'));
+  EXPECT_EQ(book.GetBestBid(), 0);
+  EXPECT_EQ(book.GetBestAsk(), 0);
+}
+
+TYPED_TEST(OrderBookTest, AddMultipleAndCancel) {
+  TypeParam book;
   book.ProcessMboMsg(CreateMboMsg(1, 10000, 10, 'B', 'A'));
   book.ProcessMboMsg(CreateMboMsg(2, 10010, 10, 'B', 'A'));
   book.ProcessMboMsg(CreateMboMsg(3, 9990, 10, 'B', 'A'));
@@ -88,3 +150,1169 @@ TEST(OrderBookTest, AddMultipleAndCancel) {
   book.ProcessMboMsg(CreateMboMsg(1, 10000, 0, 'B', 'C'));
   EXPECT_EQ(book.GetBestBid(), 9990);
 }
+
+TYPED_TEST(OrderBookTest, RepeatedLevelChurn) {
+  TypeParam book;
+  // Far more level insertions than any arena or pool could hold without
+  // recycling released nodes
+  for (int round = 0; round < 200; ++round) {
+    for (OrderId id = 1; id <= 1000; ++id) {
+      book.ProcessMboMsg(CreateMboMsg(id, 10000 - id, 10, 'B', 'A'));
+    }
+    EXPECT_EQ(book.GetBestBid(), 9999);
+    for (OrderId id = 1; id <= 1000; ++id) {
+      book.ProcessMboMsg(CreateMboMsg(id, 10000 - id, 0, 'B', 'C'));
+    }
+    EXPECT_EQ(book.GetBestBid(), 0);
+  }
+}
+
+TYPED_TEST(OrderBookTest, CheckpointRoundTrip) {
+  TypeParam book;
+  book.ProcessMboMsg(CreateMboMsg(1, 10000, 10, 'B', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(2, 10000, 20, 'B', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(3, 9990, 30, 'B', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(4, 10100, 40, 'A', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(5, 10200, 50, 'A', 'A'));
+
+  const std::string path = ::testing::TempDir() + "book.ckpt";
+  book.SaveCheckpoint(path);
+
+  TypeParam restored;
+  restored.LoadCheckpoint(path);
+  EXPECT_EQ(restored.GetBestBid(), 10000);
+  EXPECT_EQ(restored.GetBestAsk(), 10100);
+  EXPECT_EQ(restored.Position().message_count, 5u);
+
+  std::ostringstream expected, actual;
+  book.Snapshot(expected);
+  restored.Snapshot(actual);
+  EXPECT_EQ(expected.str(), actual.str());
+
+  // Queue priority must survive: order 1 is ahead of order 2, so a crossing
+  // sell for 15 fills order 1 and leaves only order 2 at 10000
+  restored.ProcessMboMsg(CreateMboMsg(6, 10000, 15, 'A', 'A'));
+  restored.ProcessMboMsg(CreateMboMsg(2, 10000, 0, 'B', 'C'));
+  EXPECT_EQ(restored.GetBestBid(), 9990);
+}
+
+TEST(CheckpointTest, PortableAcrossBooks) {
+  OrderBook book;
+  book.ProcessMboMsg(CreateMboMsg(1, 10000, 10, 'B', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(2, 10100, 10, 'A', 'A'));
+
+  const checkpoint::Writer writer = book.CreateCheckpoint();
+  checkpoint::Reader reader{writer.Data().data(), writer.Data().size()};
+  FlatMapOrderBook flat;
+  flat.LoadCheckpoint(reader);
+  EXPECT_EQ(flat.GetBestBid(), 10000);
+  EXPECT_EQ(flat.GetBestAsk(), 10100);
+}
+
+TEST(CheckpointTest, RejectsLevelCountsPastTheData) {
+  OrderBook book;
+  book.ProcessMboMsg(CreateMboMsg(1, 10000, 10, 'B', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(2, 10100, 10, 'A', 'A'));
+
+  std::vector<char> data = book.CreateCheckpoint().Data();
+  checkpoint::Level level;
+  std::memcpy(&level, data.data() + sizeof(checkpoint::Header), sizeof(level));
+  level.order_count = 1000;
+  std::memcpy(data.data() + sizeof(checkpoint::Header), &level, sizeof(level));
+  EXPECT_THROW((checkpoint::Reader{data.data(), data.size()}),
+               std::runtime_error);
+
+  // Counts that fit but disagree with the header are rejected too
+  level.order_count = 0;
+  std::memcpy(data.data() + sizeof(checkpoint::Header), &level, sizeof(level));
+  EXPECT_THROW((checkpoint::Reader{data.data(), data.size()}),
+               std::runtime_error);
+}
+
+TEST(CheckpointTest, RejectsBadSidesAndRepeatedOrders) {
+  OrderBook book;
+  book.ProcessMboMsg(CreateMboMsg(1, 10000, 10, 'B', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(2, 10100, 10, 'A', 'A'));
+
+  const std::vector<char> good = book.CreateCheckpoint().Data();
+  const size_t first_level = sizeof(checkpoint::Header);
+  const size_t first_entry = first_level + sizeof(checkpoint::Level);
+  const size_t second_entry = first_entry + sizeof(checkpoint::Entry) +
+                              sizeof(checkpoint::Level);
+
+  std::vector<char> data = good;
+  checkpoint::Level level;
+  std::memcpy(&level, data.data() + first_level, sizeof(level));
+  level.side = 'N';
+  std::memcpy(data.data() + first_level, &level, sizeof(level));
+  EXPECT_THROW((checkpoint::Reader{data.data(), data.size()}),
+               std::runtime_error);
+
+  // Give the ask the bid's order id
+  data = good;
+  checkpoint::Entry entry;
+  std::memcpy(&entry, data.data() + first_entry, sizeof(entry));
+  std::memcpy(data.data() + second_entry, &entry, sizeof(entry));
+  checkpoint::Reader reader{data.data(), data.size()};
+  OrderBook restored;
+  EXPECT_THROW(restored.LoadCheckpoint(reader), std::runtime_error);
+  EXPECT_EQ(restored.GetBestBid(), 0);
+  EXPECT_EQ(restored.GetBestAsk(), 0);
+
+  // The book is left empty and still usable
+  restored.ProcessMboMsg(CreateMboMsg(1, 9990, 5, 'B', 'A'));
+  EXPECT_EQ(restored.GetBestBid(), 9990);
+}
+
+TEST(ReplayIndexTest, FindsLatestEarlierCheckpoint) {
+  const std::string path = ::testing::TempDir() + "replay.idx";
+  {
+    FlatMapOrderBook book;
+    replay_index::Builder builder{path, 2, 0};
+    builder.Add(book.CreateCheckpoint(), 100);
+    for (OrderId id = 1; id <= 6; ++id) {
+      auto msg = CreateMboMsg(id, 10000 - id, 10, 'B', 'A');
+      msg.hd.ts_event = databento::UnixNanos{std::chrono::nanoseconds{id * 10}};
+      msg.sequence = id;
+      book.ProcessMboMsg(msg);
+      builder.OnMessage(book, 100 + id * sizeof(databento::MboMsg));
+    }
+    builder.Finish();
+  }
+
+  replay_index::Index index{path};
+  ASSERT_EQ(index.entries().size(), 4u);
+  EXPECT_EQ(index.trailer().first_ts_event, 10u);
+  EXPECT_EQ(index.FindByTsEvent(5).position.message_count, 0u);
+  EXPECT_EQ(index.FindByTsEvent(35).position.message_count, 2u);
+  EXPECT_EQ(index.FindBySequence(4).position.message_count, 4u);
+  EXPECT_EQ(index.FindBySequence(100).position.message_count, 6u);
+
+  const replay_index::Entry &entry = index.FindBySequence(4);
+  EXPECT_EQ(entry.dbn_offset, 100 + 4 * sizeof(databento::MboMsg));
+  const std::vector<char> data = index.ReadCheckpoint(entry);
+  FlatMapOrderBook restored;
+  restored.LoadCheckpoint(checkpoint::Reader{data.data(), data.size()});
+  EXPECT_EQ(restored.GetBestBid(), 9999);
+  EXPECT_EQ(restored.Position().sequence, 4u);
+}
+
+TEST(ReplayIndexTest, TimeIntervalRunsFromTheFirstMessage) {
+  const std::string path = ::testing::TempDir() + "replay_ts.idx";
+  {
+    FlatMapOrderBook book;
+    replay_index::Builder builder{path, 0, 100};
+    builder.Add(book.CreateCheckpoint(), 0);
+    // The third message steps back in time, which must not count as due
+    for (const uint64_t ts : {1000, 1050, 900, 1100, 1150}) {
+      auto msg = CreateMboMsg(ts, 10000, 10, 'B', 'A');
+      msg.hd.ts_event = databento::UnixNanos{std::chrono::nanoseconds{ts}};
+      book.ProcessMboMsg(msg);
+      builder.OnMessage(book, ts);
+    }
+    builder.Finish();
+  }
+
+  replay_index::Index index{path};
+  ASSERT_EQ(index.entries().size(), 2u);
+  EXPECT_EQ(index.entries()[1].position.message_count, 4u);
+}
+
+struct RecordingSink {
+  std::vector<FillEvent> fills;
+  std::vector<LevelEvent> added;
+  std::vector<LevelEvent> removed;
+  std::vector<BboEvent> bbos;
+
+  void OnFill(const FillEvent &fill) { fills.push_back(fill); }
+  void OnLevelAdded(const LevelEvent &level) { added.push_back(level); }
+  void OnLevelRemoved(const LevelEvent &level) { removed.push_back(level); }
+  void OnBboChanged(const BboEvent &bbo) { bbos.push_back(bbo); }
+};
+
+template <typename Book> class EventSinkTest : public ::testing::Test {};
+
+using EventSinkBookTypes =
+    ::testing::Types<BasicOrderBook<RecordingSink>,
+                     BasicFlatMapOrderBook<RecordingSink>,
+                     BasicCustomAllocationMapOrderBook<RecordingSink>>;
+TYPED_TEST_SUITE(EventSinkTest, EventSinkBookTypes);
+
+TYPED_TEST(EventSinkTest, ReportsFillsLevelsAndBbo) {
+  TypeParam book;
+  book.ProcessMboMsg(CreateMboMsg(1, 10100, 10, 'A', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(2, 10000, 10, 'B', 'A'));
+  // Adds to an existing level, so the BBO is unchanged
+  book.ProcessMboMsg(CreateMboMsg(3, 10000, 10, 'B', 'A'));
+  // Crosses: fills order 1 completely at 10100, and rests its remaining 5
+  // at its own price of 10200
+  book.ProcessMboMsg(CreateMboMsg(4, 10200, 15, 'B', 'A'));
+
+  const RecordingSink &events = book.Events();
+  ASSERT_EQ(events.fills.size(), 1u);
+  EXPECT_EQ(events.fills[0].bid_order_id, 4u);
+  EXPECT_EQ(events.fills[0].ask_order_id, 1u);
+  EXPECT_EQ(events.fills[0].price, 10100);
+  EXPECT_EQ(events.fills[0].quantity, 10u);
+  EXPECT_EQ(events.fills[0].aggressor_side, 'B');
+
+  ASSERT_EQ(events.added.size(), 3u);
+  EXPECT_EQ(events.added[2].price, 10200);
+  ASSERT_EQ(events.removed.size(), 1u);
+  EXPECT_EQ(events.removed[0].side, 'A');
+  EXPECT_EQ(events.removed[0].price, 10100);
+
+  ASSERT_EQ(events.bbos.size(), 3u);
+  EXPECT_EQ(events.bbos[2].bid, 10200);
+  EXPECT_EQ(events.bbos[2].ask, 0);
+}
+
+TEST(EventSinkTest, NullSinkTakesNoSpace) {
+  struct CacheLineSink : NullEventSink {
+    char bytes[64];
+  };
+  EXPECT_EQ(sizeof(BasicOrderBook<NullEventSink>) + 64,
+            sizeof(BasicOrderBook<CacheLineSink>));
+}
+
+TEST(MatchingEngineTest, LimitSweepsMultipleLevels) {
+  MatchingEngine engine;
+  engine.SubmitLimit(1, 'A', 10100, 10);
+  engine.SubmitLimit(2, 'A', 10200, 10);
+  engine.SubmitLimit(3, 'A', 10300, 10);
+
+  auto reports = engine.SubmitLimit(4, 'B', 10200, 25);
+  // New, then a fill pair per resting order, then nothing rests above 10200
+  ASSERT_EQ(reports.size(), 5u);
+  EXPECT_EQ(reports[0].type, ExecType::New);
+  EXPECT_EQ(reports[1].type, ExecType::PartialFill);
+  EXPECT_EQ(reports[1].price, 10100);
+  EXPECT_EQ(reports[2].order_id, 1u);
+  EXPECT_EQ(reports[2].type, ExecType::Fill);
+  EXPECT_EQ(reports[3].price, 10200);
+  EXPECT_EQ(reports[3].leaves_quantity, 5u);
+
+  // The remaining 5 rests at the limit price
+  EXPECT_EQ(engine.GetBestBid(), 10200);
+  EXPECT_EQ(engine.GetBestAsk(), 10300);
+  EXPECT_EQ(engine.OrderCount(), 2u);
+}
+
+TEST(MatchingEngineTest, ImmediateOrCancelDoesNotRest) {
+  MatchingEngine engine;
+  engine.SubmitLimit(1, 'B', 10000, 10);
+
+  auto reports =
+      engine.SubmitLimit(2, 'A', 10000, 15, TimeInForce::ImmediateOrCancel);
+  ASSERT_EQ(reports.size(), 4u);
+  EXPECT_EQ(reports.back().type, ExecType::Cancelled);
+  EXPECT_EQ(reports.back().quantity, 5u);
+  EXPECT_EQ(engine.GetBestBid(), 0);
+  EXPECT_EQ(engine.GetBestAsk(), 0);
+}
+
+TEST(MatchingEngineTest, FillOrKillIsAllOrNothing) {
+  MatchingEngine engine;
+  engine.SubmitLimit(1, 'A', 10100, 10);
+  engine.SubmitLimit(2, 'A', 10200, 10);
+
+  auto killed = engine.SubmitLimit(3, 'B', 10100, 15, TimeInForce::FillOrKill);
+  ASSERT_EQ(killed.size(), 2u);
+  EXPECT_EQ(killed[1].type, ExecType::Cancelled);
+  EXPECT_EQ(engine.GetBestAsk(), 10100);
+
+  auto filled = engine.SubmitLimit(4, 'B', 10200, 15, TimeInForce::FillOrKill);
+  EXPECT_EQ(filled.back().order_id, 2u);
+  EXPECT_EQ(filled.back().leaves_quantity, 5u);
+  EXPECT_EQ(engine.GetBestAsk(), 10200);
+}
+
+TEST(MatchingEngineTest, FillOrKillCountsDepthBeyondOneQuantity) {
+  MatchingEngine engine;
+  engine.SubmitLimit(1, 'A', 10100, 3000000000u);
+  engine.SubmitLimit(2, 'A', 10200, 3000000000u);
+
+  // 6e9 resting would wrap to about 1.7e9 in a 32-bit Quantity
+  auto filled =
+      engine.SubmitLimit(3, 'B', 10200, 4000000000u, TimeInForce::FillOrKill);
+  EXPECT_NE(filled.back().type, ExecType::Cancelled);
+  EXPECT_EQ(engine.GetBestAsk(), 10200);
+}
+
+TEST(MatchingEngineTest, MarketOrderSweepsAndCancelsRemainder) {
+  MatchingEngine engine;
+  engine.SubmitLimit(1, 'B', 10000, 10);
+  engine.SubmitLimit(2, 'B', 9000, 10);
+
+  auto reports = engine.SubmitMarket(3, 'A', 30);
+  EXPECT_EQ(reports[1].price, 10000);
+  EXPECT_EQ(reports[3].price, 9000);
+  EXPECT_EQ(reports.back().type, ExecType::Cancelled);
+  EXPECT_EQ(reports.back().quantity, 10u);
+  EXPECT_EQ(engine.GetBestBid(), 0);
+}
+
+TEST(MatchingEngineTest, ReplaceAndCancel) {
+  MatchingEngine engine;
+  engine.SubmitLimit(1, 'B', 10000, 10);
+  engine.SubmitLimit(2, 'B', 10000, 10);
+
+  // Shrinking in place keeps order 1 at the front of the queue
+  engine.Replace(1, 10000, 5);
+  auto fill = engine.SubmitLimit(3, 'A', 10000, 5);
+  EXPECT_EQ(fill[1].contra_order_id, 1u);
+
+  // Moving the price re-enters the order, and it can trade on arrival
+  engine.SubmitLimit(4, 'A', 10100, 10);
+  auto moved = engine.Replace(2, 10100, 10);
+  EXPECT_EQ(moved[0].type, ExecType::Replaced);
+  EXPECT_EQ(moved.back().type, ExecType::Fill);
+  EXPECT_EQ(engine.OrderCount(), 0u);
+
+  EXPECT_EQ(engine.Cancel(2)[0].type, ExecType::Rejected);
+  engine.SubmitLimit(5, 'B', 10000, 10);
+  EXPECT_EQ(engine.Cancel(5)[0].type, ExecType::Cancelled);
+  EXPECT_EQ(engine.GetBestBid(), 0);
+}
+
+TYPED_TEST(OrderBookTest, PublishesTopOfBook) {
+  typename TypeParam::template WithFeatures<BookFeatures::PublishTop> book;
+  // A book that does not publish carries no SeqLock
+  EXPECT_LT(sizeof(TypeParam), sizeof(book));
+  book.ProcessMboMsg(CreateMboMsg(1, 10000, 10, 'B', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(2, 10000, 20, 'B', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(3, 9990, 30, 'B', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(4, 10100, 40, 'A', 'A'));
+
+  const TopOfBook top = book.Published().Load();
+  EXPECT_EQ(top.position.message_count, 4u);
+  EXPECT_EQ(top.best_bid, 10000);
+  EXPECT_EQ(top.best_ask, 10100);
+  EXPECT_EQ(top.bid_depth, 2u);
+  EXPECT_EQ(top.ask_depth, 1u);
+  EXPECT_EQ(top.bids[0].quantity, 30u);
+  EXPECT_EQ(top.bids[0].order_count, 2u);
+  EXPECT_EQ(top.bids[1].price, 9990);
+  EXPECT_EQ(top.asks[1].price, 0);
+}
+
+TYPED_TEST(OrderBookTest, StateHashTracksQueueOrder) {
+  using Book =
+      typename TypeParam::template WithFeatures<BookFeatures::StateHash>;
+  Book book;
+  EXPECT_EQ(book.StateHash(), 0u);
+  book.ProcessMboMsg(CreateMboMsg(1, 10000, 10, 'B', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(2, 10000, 20, 'B', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(3, 10000, 30, 'B', 'A'));
+  const uint64_t hash = book.StateHash();
+
+  // Same orders, different queue order
+  Book reordered;
+  reordered.ProcessMboMsg(CreateMboMsg(2, 10000, 20, 'B', 'A'));
+  reordered.ProcessMboMsg(CreateMboMsg(1, 10000, 10, 'B', 'A'));
+  reordered.ProcessMboMsg(CreateMboMsg(3, 10000, 30, 'B', 'A'));
+  EXPECT_NE(reordered.StateHash(), hash);
+
+  // Removing the middle order and putting it back at the end, partially
+  // filling and restoring a quantity, and a checkpoint round trip all come
+  // back to the hash of an equivalent book
+  book.ProcessMboMsg(CreateMboMsg(2, 10000, 20, 'B', 'C'));
+  book.ProcessMboMsg(CreateMboMsg(3, 10000, 5, 'B', 'T'));
+  Book expected;
+  expected.ProcessMboMsg(CreateMboMsg(1, 10000, 10, 'B', 'A'));
+  expected.ProcessMboMsg(CreateMboMsg(3, 10000, 25, 'B', 'A'));
+  EXPECT_EQ(book.StateHash(), expected.StateHash());
+
+  const checkpoint::Writer writer = book.CreateCheckpoint();
+  Book restored;
+  restored.LoadCheckpoint(
+      checkpoint::Reader{writer.Data().data(), writer.Data().size()});
+  EXPECT_EQ(restored.StateHash(), book.StateHash());
+
+  // A crossing order fills against both and leaves the book empty
+  book.ProcessMboMsg(CreateMboMsg(4, 10000, 35, 'A', 'A'));
+  EXPECT_EQ(book.StateHash(), 0u);
+}
+
+TYPED_TEST(OrderBookTest, QueuePositionAndQuantityAhead) {
+  using Book =
+      typename TypeParam::template WithFeatures<BookFeatures::QueuePositions>;
+  Book book;
+  for (OrderId id = 1; id <= 4; ++id) {
+    book.ProcessMboMsg(CreateMboMsg(id, 10000, id * 10, 'B', 'A'));
+  }
+  EXPECT_EQ(book.GetQueuePosition(1), 0u);
+  EXPECT_EQ(book.GetQuantityAhead(1), 0u);
+  EXPECT_EQ(book.GetQueuePosition(4), 3u);
+  EXPECT_EQ(book.GetQuantityAhead(4), 60u);
+  EXPECT_EQ(book.GetQueuePosition(99), std::nullopt);
+
+  book.ProcessMboMsg(CreateMboMsg(2, 10000, 20, 'B', 'C'));
+  book.ProcessMboMsg(CreateMboMsg(1, 10000, 4, 'B', 'T'));
+  EXPECT_EQ(book.GetQueuePosition(4), 2u);
+  EXPECT_EQ(book.GetQuantityAhead(4), 36u);
+
+  // A modify goes to the back of the queue
+  book.ProcessMboMsg(CreateMboMsg(1, 10000, 6, 'B', 'M'));
+  EXPECT_EQ(book.GetQueuePosition(1), 2u);
+  EXPECT_EQ(book.GetQuantityAhead(1), 70u);
+  EXPECT_EQ(book.GetQuantityAhead(3), 0u);
+}
+
+TYPED_TEST(OrderBookTest, QueuePositionSurvivesSlotRenumbering) {
+  using Book =
+      typename TypeParam::template WithFeatures<BookFeatures::QueuePositions>;
+  Book book;
+  std::vector<OrderId> queue;
+  OrderId next_id = 1;
+  // Churn through many times the initial slot count at one level
+  for (int round = 0; round < 500; ++round) {
+    for (int i = 0; i < 3; ++i) {
+      book.ProcessMboMsg(CreateMboMsg(next_id, 10000, next_id % 7 + 1, 'A',
+                                      'A'));
+      queue.push_back(next_id++);
+    }
+    const size_t victim = (round * 7) % queue.size();
+    book.ProcessMboMsg(CreateMboMsg(queue[victim], 10000, 1, 'A', 'C'));
+    queue.erase(queue.begin() + victim);
+  }
+
+  uint64_t ahead = 0;
+  for (size_t i = 0; i < queue.size(); ++i) {
+    ASSERT_EQ(book.GetQueuePosition(queue[i]), i);
+    ASSERT_EQ(book.GetQuantityAhead(queue[i]), ahead);
+    ahead += queue[i] % 7 + 1;
+  }
+
+  const checkpoint::Writer writer = book.CreateCheckpoint();
+  Book restored;
+  restored.LoadCheckpoint(
+      checkpoint::Reader{writer.Data().data(), writer.Data().size()});
+  EXPECT_EQ(restored.GetQuantityAhead(queue.back()),
+            book.GetQuantityAhead(queue.back()));
+}
+
+TYPED_TEST(OrderBookTest, QuantityToPriceAndCostToFill) {
+  typename TypeParam::template WithFeatures<BookFeatures::DepthQueries> book;
+  book.ProcessMboMsg(CreateMboMsg(1, 10000, 10, 'B', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(2, 9900, 20, 'B', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(3, 9800, 30, 'B', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(4, 10100, 5, 'A', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(5, 10300, 5, 'A', 'A'));
+  EXPECT_EQ(book.QuantityToPrice('B', 10100), 0u);
+  EXPECT_EQ(book.QuantityToPrice('B', 9900), 30u);
+  EXPECT_EQ(book.QuantityToPrice('B', 9850), 30u);
+  EXPECT_EQ(book.QuantityToPrice('B', 1), 60u);
+  EXPECT_EQ(book.QuantityToPrice('A', 10200), 5u);
+
+  SweepCost cost = book.CostToFill('B', 25);
+  EXPECT_EQ(cost.quantity, 25u);
+  EXPECT_EQ(cost.worst_price, 9900);
+  EXPECT_DOUBLE_EQ(cost.average_price, 9940.0);
+  cost = book.CostToFill('A', 100);
+  EXPECT_EQ(cost.quantity, 10u);
+  EXPECT_EQ(cost.worst_price, 10300);
+  EXPECT_DOUBLE_EQ(cost.average_price, 10200.0);
+
+  // A better level off the old tick grid, a partial fill and a cancel
+  book.ProcessMboMsg(CreateMboMsg(6, 10025, 4, 'B', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(3, 9800, 10, 'B', 'T'));
+  book.ProcessMboMsg(CreateMboMsg(2, 9900, 20, 'B', 'C'));
+  EXPECT_EQ(book.QuantityToPrice('B', 10000), 14u);
+  cost = book.CostToFill('B', 34);
+  EXPECT_EQ(cost.quantity, 34u);
+  EXPECT_EQ(cost.worst_price, 9800);
+  EXPECT_DOUBLE_EQ(cost.average_price,
+                   (4 * 10025 + 10 * 10000 + 20 * 9800) / 34.0);
+
+  book.Clear();
+  EXPECT_EQ(book.CostToFill('B', 1).quantity, 0u);
+}
+
+TEST(StateHashTest, ImplementationsAgreeOnGeneratedFlow) {
+  MarketGenerator::Config config;
+  config.messages = 20000;
+  config.depth = 20;
+  BasicOrderBook<NullEventSink, BookFeatures::StateHash> map_book;
+  BasicFlatMapOrderBook<NullEventSink, BookFeatures::StateHash> flat_book;
+  BasicCustomAllocationMapOrderBook<NullEventSink, BookFeatures::StateHash>
+      custom_book;
+  MarketGenerator generator{config};
+  databento::MboMsg msg;
+  while (generator.Next(msg)) {
+    map_book.ProcessMboMsg(msg);
+    flat_book.ProcessMboMsg(msg);
+    custom_book.ProcessMboMsg(msg);
+    ASSERT_EQ(flat_book.StateHash(), map_book.StateHash()) << msg.sequence;
+    ASSERT_EQ(custom_book.StateHash(), map_book.StateHash()) << msg.sequence;
+  }
+  EXPECT_NE(map_book.StateHash(), 0u);
+}
+
+// The flash crash moves the asks through several windows, leaving levels
+// behind in the overflow
+TEST(DepthLadderTest, AgreesWithPublishedLevelsOnGeneratedFlow) {
+  MarketGenerator::Config config;
+  config.condition = MarketCondition::FlashCrash;
+  config.messages = 20000;
+  config.depth = 20;
+  BasicOrderBook<NullEventSink,
+                 BookFeatures::PublishTop | BookFeatures::DepthQueries>
+      book;
+  MarketGenerator generator{config};
+  databento::MboMsg msg;
+  while (generator.Next(msg)) {
+    book.ProcessMboMsg(msg);
+    if (msg.sequence % 97 != 0) {
+      continue;
+    }
+    const TopOfBook top = book.Published().Load();
+    for (const auto &[side, levels] : {std::pair{'B', top.bids},
+                                       std::pair{'A', top.asks}}) {
+      uint64_t total = 0;
+      for (size_t i = 0; i < kPublishedDepth && levels[i].quantity; ++i) {
+        total += levels[i].quantity;
+        ASSERT_EQ(book.QuantityToPrice(side, levels[i].price), total);
+        const SweepCost cost = book.CostToFill(side, total);
+        ASSERT_EQ(cost.quantity, total);
+        ASSERT_EQ(cost.worst_price, levels[i].price);
+      }
+    }
+  }
+}
+
+TEST(DepthLadderTest, FollowsTheBookOutWhenTheWindowEmpties) {
+  DepthLadder ladder{'A'};
+  ladder.Add(100, 10);
+  ladder.Add(101, 1);
+  ladder.Add(100000, 5); // Past the window
+  ladder.Add(100001, 7);
+  ladder.Add(100, -10);
+  ladder.Add(101, -1);
+
+  EXPECT_EQ(ladder.QuantityTo(99999), 0u);
+  EXPECT_EQ(ladder.QuantityTo(100000), 5u);
+  const SweepCost cost = ladder.CostToFill(12);
+  EXPECT_EQ(cost.quantity, 12u);
+  EXPECT_EQ(cost.worst_price, 100001);
+  EXPECT_DOUBLE_EQ(cost.average_price, (5 * 100000 + 7 * 100001) / 12.0);
+
+  ladder.Add(100, 3);
+  EXPECT_EQ(ladder.QuantityTo(100000), 8u);
+  EXPECT_EQ(ladder.CostToFill(4).worst_price, 100000);
+}
+
+TEST(SeqLockTest, ReadersNeverSeeTornWrites) {
+  struct Wide {
+    uint64_t values[32];
+  };
+  SeqLock<Wide> slot;
+  std::atomic<bool> done{false};
+
+  std::thread writer([&] {
+    Wide wide;
+    for (uint64_t i = 1; i <= 200000; ++i) {
+      std::fill(std::begin(wide.values), std::end(wide.values), i);
+      slot.Store(wide);
+    }
+    done = true;
+  });
+
+  uint64_t torn = 0;
+  while (!done) {
+    const Wide wide = slot.Load();
+    for (uint64_t value : wide.values) {
+      torn += value != wide.values[0];
+    }
+  }
+  writer.join();
+
+  EXPECT_EQ(torn, 0u);
+  EXPECT_EQ(slot.Version(), 200000u);
+  EXPECT_EQ(slot.Load().values[31], 200000u);
+}
+
+TEST(SharedBookTest, ReaderSeesPublishedInstruments) {
+  const std::string name = "/orderbook_shared_book_test";
+  shared_book::Publisher publisher(name, 4);
+  shared_book::Reader reader(name);
+
+  BasicFlatMapOrderBook<NullEventSink, BookFeatures::PublishTop> book;
+  book.ProcessMboMsg(CreateMboMsg(1, 100, 10, 'B', 'A'));
+  book.ProcessMboMsg(CreateMboMsg(2, 101, 5, 'A', 'A'));
+  publisher.Publish(7, book.Published().Load());
+
+  TopOfBook top;
+  EXPECT_FALSE(reader.Read(8, top));
+  ASSERT_TRUE(reader.Read(7, top));
+  EXPECT_EQ(top.best_bid, 100);
+  EXPECT_EQ(top.best_ask, 101);
+  EXPECT_EQ(top.bids[0].quantity, 10u);
+  EXPECT_EQ(reader.Version(7), 1u);
+
+  book.ProcessMboMsg(CreateMboMsg(2, 101, 5, 'A', 'C'));
+  publisher.Publish(7, book.Published().Load());
+  publisher.Publish(8, book.Published().Load());
+  ASSERT_TRUE(reader.Read(7, top));
+  EXPECT_EQ(top.best_ask, 0);
+  EXPECT_EQ(reader.Version(7), 2u);
+  EXPECT_EQ(reader.Instruments(), (std::vector<uint32_t>{7, 8}));
+
+  shared_book::Publisher::Unlink(name);
+}
+
+TEST(DatagramFeedTest, SequenceTrackerCountsGaps) {
+  feed::SequenceTracker tracker;
+  EXPECT_TRUE(tracker.Accept(1, 3));
+  EXPECT_TRUE(tracker.Accept(4, 2));
+  EXPECT_TRUE(tracker.Accept(10, 1)); // Records 6-9 lost
+  EXPECT_FALSE(tracker.Accept(6, 2)); // Arrived too late
+  EXPECT_TRUE(tracker.Accept(11, 1));
+
+  EXPECT_EQ(tracker.gaps(), 1u);
+  EXPECT_EQ(tracker.missing_records(), 4u);
+  EXPECT_EQ(tracker.stale_packets(), 1u);
+}
+
+TEST(DatagramFeedTest, DeliversRecordsOverUnixSocket) {
+  const std::string endpoint = "unix:/tmp/orderbook_feed_test.sock";
+  feed::Receiver receiver(endpoint, 8);
+  feed::Sender sender(endpoint);
+
+  // More records than fit in one datagram
+  constexpr uint64_t kRecords = 100;
+  for (uint64_t i = 1; i <= kRecords; ++i) {
+    databento::MboMsg msg = CreateMboMsg(i, 100 + i, 1, 'B', 'A');
+    msg.hd.length = sizeof(databento::MboMsg) / 4;
+    sender.Add(databento::Record{&msg.hd});
+  }
+  sender.Finish();
+
+  FlatMapOrderBook book;
+  uint64_t received = 0;
+  while (receiver.Poll([&](const databento::Record &record,
+                           const feed::PacketHeader &) {
+    book.ProcessMboMsg(record.Get<databento::MboMsg>());
+    ++received;
+  })) {
+  }
+
+  EXPECT_EQ(received, kRecords);
+  EXPECT_GT(receiver.packets(), 2u);
+  EXPECT_EQ(receiver.Sequence().gaps(), 0u);
+  EXPECT_EQ(book.GetBestBid(), 200);
+}
+
+void WriteDbnFile(const std::string &path,
+                  const std::vector<databento::MboMsg> &msgs) {
+  databento::Metadata metadata{};
+  metadata.version = 1;
+  metadata.dataset = "TEST_DATASET";
+  metadata.schema = databento::Schema::Mbo;
+  metadata.stype_in = databento::SType::RawSymbol;
+  metadata.stype_out = databento::SType::InstrumentId;
+  metadata.symbol_cstr_len = 128;
+  databento::OutFileStream file_stream{std::filesystem::path{path}};
+  databento::DbnEncoder encoder{metadata, &file_stream};
+  for (databento::MboMsg msg : msgs) {
+    msg.hd.length = sizeof(databento::MboMsg) / 4;
+    encoder.EncodeRecord(msg);
+  }
+}
+
+databento::MboMsg CreateTimedMboMsg(OrderId order_id, uint64_t ts_recv,
+                                    uint32_t sequence) {
+  databento::MboMsg msg = CreateMboMsg(order_id, 100, 1, 'B', 'A');
+  msg.ts_recv = databento::UnixNanos{std::chrono::nanoseconds{ts_recv}};
+  msg.sequence = sequence;
+  return msg;
+}
+
+TEST(DbnMergeReaderTest, InterleavesFilesByTsRecvThenSequence) {
+  const std::string first = ::testing::TempDir() + "merge_first.dbn";
+  const std::string second = ::testing::TempDir() + "merge_second.dbn";
+  WriteDbnFile(first,
+               {CreateTimedMboMsg(1, 10, 1), CreateTimedMboMsg(2, 30, 2),
+                CreateTimedMboMsg(3, 30, 5), CreateTimedMboMsg(4, 50, 6)});
+  WriteDbnFile(second,
+               {CreateTimedMboMsg(5, 20, 3), CreateTimedMboMsg(6, 30, 4),
+                CreateTimedMboMsg(7, 60, 7)});
+
+  // A batch size of 2 makes every file span several batches
+  DbnMergeReader reader{{first, second}, 2, 1};
+  std::vector<OrderId> order_ids;
+  while (const databento::MboMsg *msg = reader.Next()) {
+    order_ids.push_back(msg->order_id);
+  }
+
+  EXPECT_EQ(order_ids, (std::vector<OrderId>{1, 5, 2, 6, 3, 4, 7}));
+}
+
+TEST(MessageCacheTest, RoundTripsThroughColumnarFile) {
+  const std::string dbn = ::testing::TempDir() + "cache.dbn";
+  WriteDbnFile(dbn, {CreateMboMsg(1, 100, 10, 'B', 'A'),
+                     CreateMboMsg(2, 101, 5, 'A', 'A'),
+                     CreateMboMsg(2, 101, 5, 'A', 'C'),
+                     CreateTimedMboMsg(3, 42, 7)});
+  std::filesystem::remove(message_cache::PathFor(dbn));
+
+  const message_cache::View built = message_cache::Open(dbn);
+  const message_cache::View mapped = message_cache::Open(dbn);
+  ASSERT_EQ(mapped.size(), 4u);
+  EXPECT_EQ(mapped.price()[1], 101);
+  EXPECT_EQ(mapped.side()[1], 'A');
+  EXPECT_EQ(mapped[3].ts_recv.time_since_epoch().count(), 42u);
+  EXPECT_EQ(mapped[3].sequence, 7u);
+
+  const auto histogram = message_cache::ActionHistogram(mapped);
+  EXPECT_EQ(histogram['A'], 3u);
+  EXPECT_EQ(histogram['C'], 1u);
+
+  FlatMapOrderBook book;
+  for (const auto &msg : mapped) {
+    book.ProcessMboMsg(msg);
+  }
+  EXPECT_EQ(book.GetBestBid(), 100);
+  EXPECT_EQ(book.GetBestAsk(), 0);
+  EXPECT_EQ(book.Position().sequence, 7u);
+}
+
+std::vector<char> ReadFile(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+// Compresses data as consecutive independent frames of frame_size input
+// bytes each, which need not line up with record boundaries
+void WriteZstdFile(const std::string &path, const std::vector<char> &data,
+                   size_t frame_size) {
+  std::ofstream out(path, std::ios::binary);
+  for (size_t offset = 0; offset < data.size(); offset += frame_size) {
+    const size_t size = std::min(frame_size, data.size() - offset);
+    std::vector<char> frame(ZSTD_compressBound(size));
+    const size_t written = ZSTD_compress(frame.data(), frame.size(),
+                                         data.data() + offset, size, 3);
+    ASSERT_FALSE(ZSTD_isError(written));
+    out.write(frame.data(), written);
+  }
+}
+
+TEST(ParallelDbnReaderTest, ReadsPlainSingleFrameAndMultiFrameFiles) {
+  std::vector<databento::MboMsg> msgs;
+  for (OrderId id = 1; id <= 500; ++id) {
+    msgs.push_back(CreateTimedMboMsg(id, id * 10, id));
+  }
+  const std::string plain = ::testing::TempDir() + "parallel.dbn";
+  WriteDbnFile(plain, msgs);
+  const std::vector<char> data = ReadFile(plain);
+
+  const std::string single = ::testing::TempDir() + "parallel_single.dbn.zst";
+  const std::string multi = ::testing::TempDir() + "parallel_multi.dbn.zst";
+  WriteZstdFile(single, data, data.size());
+  WriteZstdFile(multi, data, 1000);
+
+  for (const std::string &path : {plain, single, multi}) {
+    // A two-slot ring keeps the workers waiting on the reader
+    ParallelDbnReader reader{path, 4, 2};
+    std::vector<OrderId> order_ids;
+    while (const databento::Record *record = reader.NextRecord()) {
+      order_ids.push_back(record->Get<databento::MboMsg>().order_id);
+    }
+    ASSERT_EQ(order_ids.size(), msgs.size()) << path;
+    EXPECT_EQ(order_ids.front(), 1u);
+    EXPECT_EQ(order_ids.back(), 500u);
+    EXPECT_TRUE(std::is_sorted(order_ids.begin(), order_ids.end()));
+  }
+  EXPECT_GT(ParallelDbnReader(multi).frame_count(), 10u);
+}
+
+TEST(UringReaderTest, ReadsBlocksInFileOrder) {
+  std::vector<char> data(100000);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<char>(i * 7 + i / 251);
+  }
+  const std::string path = ::testing::TempDir() + "uring.bin";
+  std::ofstream(path, std::ios::binary).write(data.data(), data.size());
+
+  for (bool direct_io : {false, true}) {
+    // Two 4 KiB buffers, so every buffer is reused many times
+    UringReader reader{path, 4096, 2, direct_io};
+    std::vector<char> read;
+    for (auto block = reader.Next(); !block.empty(); block = reader.Next()) {
+      const auto *bytes = reinterpret_cast<const char *>(block.data());
+      read.insert(read.end(), bytes, bytes + block.size());
+    }
+    EXPECT_EQ(read, data);
+    EXPECT_TRUE(reader.Next().empty());
+  }
+}
+
+TEST(RunModeTest, PinsOnlyTheCallingThread) {
+  cpu_set_t before;
+  ASSERT_EQ(sched_getaffinity(0, sizeof(before), &before), 0);
+  const int cpu = sched_getcpu();
+
+  std::thread thread([cpu] {
+    run_mode::PinCurrentThread(cpu);
+    EXPECT_EQ(sched_getcpu(), cpu);
+    EXPECT_THROW(run_mode::PinCurrentThread(CPU_SETSIZE - 1),
+                 std::runtime_error);
+    run_mode::PrefaultStack();
+  });
+  thread.join();
+
+  cpu_set_t after;
+  ASSERT_EQ(sched_getaffinity(0, sizeof(after), &after), 0);
+  EXPECT_TRUE(CPU_EQUAL(&before, &after));
+}
+
+std::vector<databento::MboMsg>
+GenerateMessages(const MarketGenerator::Config &config) {
+  MarketGenerator generator{config};
+  std::vector<databento::MboMsg> msgs;
+  databento::MboMsg msg;
+  while (generator.Next(msg)) {
+    msgs.push_back(msg);
+  }
+  return msgs;
+}
+
+TEST(MarketGeneratorTest, SameSeedReproducesTheStream) {
+  MarketGenerator::Config config;
+  config.condition = MarketCondition::FlashCrash;
+  config.messages = 20000;
+  config.instruments = 3;
+  config.depth = 10;
+  const std::vector<databento::MboMsg> first = GenerateMessages(config);
+  const std::vector<databento::MboMsg> second = GenerateMessages(config);
+  ASSERT_EQ(first.size(), 20000u + 3 * 10 * 2);
+  ASSERT_EQ(second.size(), first.size());
+  EXPECT_EQ(std::memcmp(first.data(), second.data(),
+                        first.size() * sizeof(databento::MboMsg)),
+            0);
+
+  config.seed = 43;
+  const std::vector<databento::MboMsg> reseeded = GenerateMessages(config);
+  EXPECT_NE(std::memcmp(first.data(), reseeded.data(),
+                        first.size() * sizeof(databento::MboMsg)),
+            0);
+}
+
+TEST(MarketGeneratorTest, SequencesStartAtFirstSequence) {
+  MarketGenerator::Config config;
+  config.messages = 1000;
+  config.instruments = 2;
+  config.depth = 5;
+  config.first_sequence = 5001;
+
+  std::unordered_map<uint32_t, uint32_t> last; // instrument to sequence
+  for (const databento::MboMsg &msg : GenerateMessages(config)) {
+    auto [it, first] = last.emplace(msg.hd.instrument_id, msg.sequence);
+    if (first) {
+      EXPECT_EQ(msg.sequence, 5001u);
+    } else {
+      EXPECT_EQ(msg.sequence, it->second + 1);
+      it->second = msg.sequence;
+    }
+  }
+  EXPECT_EQ(last.size(), 2u);
+}
+
+TEST(MarketGeneratorTest, CancelsAndModifiesTargetLiveOrders) {
+  MarketGenerator::Config config;
+  config.condition = MarketCondition::BookChurn;
+  config.messages = 20000;
+  config.instruments = 2;
+  config.depth = 5;
+  config.max_live_orders = 50;
+
+  std::unordered_map<uint64_t, uint32_t> live; // order id to instrument
+  uint64_t previous_ts_recv = 0;
+  for (const databento::MboMsg &msg : GenerateMessages(config)) {
+    const uint64_t ts_recv = msg.ts_recv.time_since_epoch().count();
+    EXPECT_GT(ts_recv, previous_ts_recv);
+    previous_ts_recv = ts_recv;
+    ASSERT_GE(msg.hd.instrument_id, 1u);
+    ASSERT_LE(msg.hd.instrument_id, 2u);
+
+    if (msg.action == databento::Action::Add) {
+      EXPECT_TRUE(live.emplace(msg.order_id, msg.hd.instrument_id).second);
+      continue;
+    }
+    const auto it = live.find(msg.order_id);
+    ASSERT_NE(it, live.end());
+    EXPECT_EQ(it->second, msg.hd.instrument_id);
+    if (msg.action == databento::Action::Cancel) {
+      live.erase(it);
+    }
+  }
+}
+
+databento::MboMsg AtTime(databento::MboMsg msg, uint64_t ts_recv) {
+  msg.ts_recv = databento::UnixNanos{std::chrono::nanoseconds{ts_recv}};
+  return msg;
+}
+
+TEST(AnalyticsTest, TracksImbalanceMicropriceAndWindow) {
+  analytics::Config config;
+  config.top_levels = 2;
+  config.window_nanos = 64000; // 1 us buckets
+  BasicFlatMapOrderBook<NullEventSink, BookFeatures::PublishTop> book;
+  analytics::Stage stage{config};
+  auto apply = [&](const databento::MboMsg &msg) {
+    book.ProcessMboMsg(msg);
+    return stage.Update(msg, book);
+  };
+
+  apply(AtTime(CreateMboMsg(1, 10000, 10, 'B', 'A'), 1000));
+  analytics::Sample sample =
+      apply(AtTime(CreateMboMsg(2, 10100, 30, 'A', 'A'), 2000));
+  EXPECT_DOUBLE_EQ(sample.microprice, 10025.0);
+  EXPECT_FLOAT_EQ(sample.imbalance, -0.5f);
+  EXPECT_DOUBLE_EQ(sample.time_weighted_spread, 100.0);
+
+  sample = apply(AtTime(CreateMboMsg(3, 9900, 20, 'B', 'A'), 3000));
+  EXPECT_FLOAT_EQ(sample.imbalance, 0.0f);
+  apply(AtTime(CreateMboMsg(4, 10050, 10, 'A', 'A'), 5000));
+  sample = apply(AtTime(CreateMboMsg(4, 10050, 10, 'A', 'C'), 7000));
+  // 100 for 3 us, then 50 for 2 us
+  EXPECT_DOUBLE_EQ(sample.time_weighted_spread, 80.0);
+  EXPECT_EQ(sample.adds, 4u);
+  EXPECT_EQ(sample.cancels, 1u);
+
+  // The adds have left the window, the cancel has not
+  sample = apply(AtTime(CreateMboMsg(1, 10000, 5, 'B', 'M'), 70000));
+  EXPECT_EQ(sample.adds, 0u);
+  EXPECT_EQ(sample.cancels, 1u);
+  EXPECT_EQ(sample.modifies, 1u);
+  EXPECT_DOUBLE_EQ(sample.time_weighted_spread, 100.0);
+
+  sample = apply(AtTime(CreateMboMsg(5, 9900, 5, 'B', 'A'), 1000000000));
+  EXPECT_EQ(sample.cancels + sample.modifies, 0u);
+  EXPECT_EQ(sample.adds, 1u);
+  EXPECT_DOUBLE_EQ(sample.time_weighted_spread, 100.0);
+
+  // One execution, reported as a trade and then as a fill
+  apply(AtTime(CreateMboMsg(0, 10100, 5, 'B', 'T'), 1000001000));
+  sample = apply(AtTime(CreateMboMsg(2, 10100, 5, 'A', 'F'), 1000001000));
+  EXPECT_EQ(sample.trades, 1u);
+}
+
+TEST(AnalyticsTest, RoundTripsThroughFile) {
+  const std::string path = ::testing::TempDir() + "analytics.msta";
+  analytics::Stage stage;
+  BasicFlatMapOrderBook<NullEventSink, BookFeatures::PublishTop> book;
+  std::vector<analytics::Sample> written;
+  {
+    analytics::Writer writer{path, analytics::Config{}};
+    for (OrderId id = 1; id <= 3; ++id) {
+      const databento::MboMsg msg =
+          AtTime(CreateMboMsg(id, 10000 + id, 10, id % 2 ? 'B' : 'A', 'A'),
+                 id * 1000);
+      book.ProcessMboMsg(msg);
+      written.push_back(stage.Update(msg, book));
+      writer.Write(written.back());
+    }
+    writer.Flush();
+  }
+
+  const std::vector<analytics::Sample> read = analytics::Read(path);
+  ASSERT_EQ(read.size(), written.size());
+  for (size_t i = 0; i < read.size(); ++i) {
+    EXPECT_EQ(std::memcmp(&read[i], &written[i], sizeof(analytics::Sample)),
+              0);
+  }
+}
+
+TEST(BarsTest, TimeVolumeAndTickBars) {
+  std::vector<bars::Bar> out;
+  auto emit = [&](const bars::Bar &bar) { out.push_back(bar); };
+
+  bars::Builder time{7, {bars::BarType::Time, 1000}};
+  time.AddTrade(100, 10, 1, emit);
+  time.AddTrade(900, 12, 2, emit);
+  time.AddTrade(1500, 11, 3, emit);
+  ASSERT_EQ(out.size(), 1u);
+  EXPECT_EQ(out[0].first_ts, 100u);
+  EXPECT_EQ(out[0].last_ts, 900u);
+  EXPECT_EQ(out[0].open, 10);
+  EXPECT_EQ(out[0].high, 12);
+  EXPECT_EQ(out[0].close, 12);
+  EXPECT_EQ(out[0].volume, 3u);
+  EXPECT_EQ(out[0].trades, 2u);
+  EXPECT_DOUBLE_EQ(out[0].vwap, 34.0 / 3);
+  EXPECT_EQ(out[0].instrument_id, 7u);
+  time.AddTrade(3100, 9, 1, emit);
+  time.Flush(emit);
+  ASSERT_EQ(out.size(), 3u);
+  EXPECT_EQ(out[1].volume, 3u);
+  EXPECT_EQ(out[2].low, 9);
+
+  // The 4 and 8 lot trades are split across bars of exactly 5
+  out.clear();
+  bars::Builder volume{7, {bars::BarType::Volume, 5}};
+  volume.AddTrade(1, 10, 3, emit);
+  volume.AddTrade(2, 11, 4, emit);
+  volume.AddTrade(3, 12, 8, emit);
+  volume.Flush(emit);
+  ASSERT_EQ(out.size(), 3u);
+  EXPECT_DOUBLE_EQ(out[0].vwap, 10.4);
+  EXPECT_EQ(out[1].open, 11);
+  EXPECT_EQ(out[1].close, 12);
+  EXPECT_EQ(out[2].volume, 5u);
+
+  out.clear();
+  bars::Builder tick{7, {bars::BarType::Tick, 2}};
+  for (uint64_t ts = 1; ts <= 3; ++ts) {
+    tick.AddTrade(ts, 10, 1, emit);
+  }
+  tick.Flush(emit);
+  ASSERT_EQ(out.size(), 2u);
+  EXPECT_EQ(out[0].trades, 2u);
+  EXPECT_EQ(out[1].trades, 1u);
+}
+
+TEST(BarsTest, RoundTripsThroughColumnarFile) {
+  const std::string path = ::testing::TempDir() + "trades.bars";
+  std::vector<bars::Bar> written;
+  {
+    bars::Writer writer{path, bars::Config{}};
+    for (uint64_t i = 0; i < bars::Writer::kBlockBars + 3; ++i) {
+      const auto price = static_cast<Price>(100 + i % 7);
+      written.push_back(bars::Bar{i, i + 1, price, price + 1, price - 1,
+                                  price, i * 10, price + 0.5,
+                                  static_cast<uint32_t>(i % 5),
+                                  static_cast<uint32_t>(i % 3)});
+      writer.Write(written.back());
+    }
+    writer.Flush();
+  }
+
+  const std::vector<bars::Bar> read = bars::Read(path);
+  ASSERT_EQ(read.size(), written.size());
+  for (size_t i = 0; i < read.size(); ++i) {
+    ASSERT_EQ(std::memcmp(&read[i], &written[i], sizeof(bars::Bar)), 0) << i;
+  }
+}
+
+// Records the test book into path and reads the file back
+heatmap::Matrix RecordHeatmap(const std::string &path) {
+  heatmap::Config config;
+  config.bin_nanos = 1000;
+  config.rows = 4;
+  heatmap::Recorder recorder{7, config, path};
+  BasicFlatMapOrderBook<NullEventSink, BookFeatures::DepthQueries> book;
+  auto apply = [&](const databento::MboMsg &msg) {
+    recorder.Update(msg, book);
+    book.ProcessMboMsg(msg);
+  };
+  apply(AtTime(CreateMboMsg(1, 10000, 10, 'B', 'A'), 100));
+  // Only one price before the first bin ends, so there is no step yet
+  apply(AtTime(CreateMboMsg(2, 9990, 5, 'B', 'A'), 1100));
+  apply(AtTime(CreateMboMsg(3, 10020, 7, 'A', 'A'), 1200));
+  // Nothing happens in the bin at 2000, which repeats the one before
+  apply(AtTime(CreateMboMsg(2, 9990, 0, 'B', 'C'), 3500));
+  recorder.Finish(book);
+  EXPECT_EQ(recorder.ColumnCount(), 4u);
+  return heatmap::Read(path);
+}
+
+TEST(HeatmapTest, BinsDepthByPriceAndTime) {
+  const heatmap::Matrix matrix =
+      RecordHeatmap(::testing::TempDir() + "bins.heat");
+  EXPECT_EQ(matrix.header.instrument_id, 7u);
+  EXPECT_EQ(matrix.header.price_step, 10);
+  ASSERT_EQ(matrix.columns.size(), 4u);
+
+  EXPECT_EQ(matrix.columns[0].ts, 0u);
+  EXPECT_EQ(matrix.columns[0].first_row, heatmap::kNoRows);
+  const std::vector<float> empty{0, 0, 0, 0};
+  EXPECT_EQ(std::vector<float>(matrix.Cells(0), matrix.Cells(0) + 4), empty);
+
+  // Centred on the mid of 10000 and 10020: rows 9990, 10000, 10010, 10020
+  const std::vector<float> both{5, 10, 0, 7};
+  for (size_t i : {1, 2}) {
+    EXPECT_EQ(matrix.columns[i].ts, i * 1000);
+    EXPECT_EQ(matrix.columns[i].best_bid, 10000);
+    EXPECT_EQ(matrix.columns[i].best_ask, 10020);
+    EXPECT_EQ(matrix.columns[i].first_row, 999);
+    EXPECT_EQ(std::vector<float>(matrix.Cells(i), matrix.Cells(i) + 4), both);
+  }
+  const std::vector<float> after_cancel{0, 10, 0, 7};
+  EXPECT_EQ(matrix.columns[3].ts, 3000u);
+  EXPECT_EQ(std::vector<float>(matrix.Cells(3), matrix.Cells(3) + 4),
+            after_cancel);
+}
+
+TEST(HeatmapTest, StreamsColumnsAndRendersPng) {
+  const std::string path = ::testing::TempDir() + "depth.heat";
+  const heatmap::Matrix matrix = RecordHeatmap(path);
+  heatmap::Reader reader{path};
+  EXPECT_EQ(std::memcmp(&reader.header(), &matrix.header,
+                        sizeof(matrix.header)),
+            0);
+  heatmap::Column column;
+  std::vector<float> cells;
+  for (size_t i = 0; i < matrix.columns.size(); ++i) {
+    ASSERT_TRUE(reader.Next(column, cells));
+    EXPECT_EQ(std::memcmp(&column, &matrix.columns[i], sizeof(column)), 0);
+    EXPECT_EQ(cells, std::vector<float>(matrix.Cells(i),
+                                        matrix.Cells(i) + 4));
+  }
+  EXPECT_FALSE(reader.Next(column, cells));
+
+  // Two columns per pixel, and every row of the four-row window
+  const std::string png_path = ::testing::TempDir() + "depth.png";
+  heatmap::WritePng(png_path, reader, heatmap::RenderConfig{2, 100});
+  std::ifstream in(png_path, std::ios::binary);
+  const std::string png{std::istreambuf_iterator<char>(in), {}};
+  ASSERT_EQ(png.substr(1, 3), "PNG");
+  EXPECT_EQ(png.substr(12, 4), "IHDR");
+  EXPECT_EQ(png.substr(16, 8), std::string("\0\0\0\2\0\0\0\4", 8));
+  // Signature, IHDR, a single stored block of 4 * (1 + 2 * 3) bytes, IEND
+  EXPECT_EQ(png.size(), 8 + 25 + 12 + 2 + 5 + 28 + 4 + 12);
+}
+
+TEST(SnapshotSamplerTest, SamplesEveryMessageAndInterval) {
+  SnapshotSampler::Config config;
+  config.every_messages = 3;
+  config.every_nanos = 1000;
+  SnapshotSampler sampler{config};
+  BasicFlatMapOrderBook<NullEventSink, BookFeatures::PublishTop> book;
+  std::vector<bool> sampled;
+  const uint64_t times[] = {100, 200, 300, 400, 1500, 1600, 1700, 1800};
+  for (size_t i = 0; i < std::size(times); ++i) {
+    auto msg = CreateMboMsg(i + 1, 10000 - i, 1, 'B', 'A');
+    msg.hd.ts_event = databento::UnixNanos{std::chrono::nanoseconds{times[i]}};
+    book.ProcessMboMsg(msg);
+    sampled.push_back(sampler.Sample(msg, book));
+  }
+  // The first message of each interval, and the 3rd and 6th messages
+  EXPECT_EQ(sampled, (std::vector<bool>{true, false, true, false, true,
+                                        true, false, false}));
+
+  SnapshotSampler every_message{SnapshotSampler::Config{}};
+  EXPECT_FALSE(every_message.Enabled());
+  EXPECT_TRUE(every_message.Sample(CreateMboMsg(1, 1, 1, 'B', 'A'), book));
+}
+
+TEST(SnapshotSamplerTest, SamplesWhenTopLevelsChange) {
+  SnapshotSampler::Config config;
+  config.top_levels = 2;
+  SnapshotSampler sampler{config};
+  BasicFlatMapOrderBook<NullEventSink, BookFeatures::PublishTop> book;
+  auto apply = [&](const databento::MboMsg &msg) {
+    book.ProcessMboMsg(msg);
+    return sampler.Sample(msg, book);
+  };
+  EXPECT_TRUE(apply(CreateMboMsg(1, 10000, 10, 'B', 'A')));
+  EXPECT_TRUE(apply(CreateMboMsg(2, 9990, 10, 'B', 'A')));
+  // Below the watched levels
+  EXPECT_FALSE(apply(CreateMboMsg(3, 9980, 10, 'B', 'A')));
+  EXPECT_FALSE(apply(CreateMboMsg(3, 9980, 0, 'B', 'C')));
+  EXPECT_TRUE(apply(CreateMboMsg(4, 9990, 5, 'B', 'A')));
+  EXPECT_TRUE(apply(CreateMboMsg(5, 10100, 5, 'A', 'A')));
+
+  config.top_levels = kPublishedDepth + 1;
+  EXPECT_THROW(SnapshotSampler{config}, std::invalid_argument);
+}